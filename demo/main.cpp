@@ -1,6 +1,8 @@
 #include <raygun.h>
 
+#include <fstream>
 #include <iostream>
+#include <vector>
 
 #include <cstdlib>
 
@@ -46,7 +48,14 @@ setup(void* ptr, RTCDevice device, RTCScene scene)
 }
 
 void
-trace(void* ptr, RTCScene scene, const uint32_t num_rays, const RTCRayHit* ray_hit, float* r, float* g, float* b)
+trace(void* ptr,
+      RTCScene scene,
+      raygun_context* context,
+      const uint32_t num_rays,
+      const RTCRayHit* ray_hit,
+      float* r,
+      float* g,
+      float* b)
 {
   for (uint32_t i = 0; i < num_rays; i++) {
     if (ray_hit[i].hit.geomID != RTC_INVALID_GEOMETRY_ID) {
@@ -76,16 +85,63 @@ const raygun_interface interface {
   /*trace4=*/nullptr,
   /*trace8=*/nullptr,
   /*trace16=*/nullptr,
-  on_error
+  on_error,
+  /*stats=*/nullptr,
+  /*shade=*/nullptr
   // clang-format on
 };
 
+#ifndef RAYGUN_GL
+/**
+ * Writes an image that was rendered headless as a binary PPM file. The rows are stored top to bottom.
+ * */
+auto
+save_ppm(const char* path, const std::vector<float>& image, const int w, const int h) -> bool
+{
+  std::ofstream file(path, std::ios::binary);
+
+  file << "P6\n" << w << ' ' << h << "\n255\n";
+
+  for (int y = h - 1; y >= 0; y--) {
+    for (int x = 0; x < w * 3; x++) {
+      const float v = image[(y * w) * 3 + x];
+      file.put(static_cast<char>((v < 0.0f) ? 0 : ((v > 1.0f) ? 255 : static_cast<int>(v * 255.0f + 0.5f))));
+    }
+  }
+
+  return file.good();
+}
+#endif
+
 } // namespace
 
 auto
 main() -> int
 {
+#ifdef RAYGUN_GL
   raygun_exec(/*caller_data=*/nullptr, &interface, "Raygun Demo", /*embree_config=*/nullptr);
+#else
+  const int w = 640;
+  const int h = 480;
+
+  std::vector<float> image(w * h * 3);
+
+  raygun_config config;
+
+  raygun_config_init(&config);
+
+  const int frames =
+    raygun_render_headless(nullptr, &interface, &config, w, h, image.data(), /*max_frames=*/16, /*time_limit=*/0);
+
+  if (frames < 0) {
+    return EXIT_FAILURE;
+  }
+
+  if (!save_ppm("demo.ppm", image, w, h)) {
+    std::cerr << "ERROR: Failed to write demo.ppm" << std::endl;
+    return EXIT_FAILURE;
+  }
+#endif
 
   return EXIT_SUCCESS;
 }
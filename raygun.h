@@ -6,6 +6,7 @@
 
 #include <embree3/rtcore.h>
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -14,52 +15,345 @@ extern "C"
 #endif
 
   /**
+   * @brief The camera that primary rays are generated from.
+   *
+   * @note The camera has a field of view of 90 degrees, both horizontally and vertically. The up vector is +Y, unless
+   *       the camera looks along the Y axis, in which case it is -Z.
    * */
   struct raygun_camera
   {
     float pos[3];
 
+    /**
+     * @brief The view direction. This does not have to be normalized.
+     * */
     float dir[3];
 
+    /**
+     * @brief The start of the ray interval of primary rays.
+     * */
     float tnear;
 
+    /**
+     * @brief The end of the ray interval of primary rays. Keeping this tight lets Embree skip more of the scene.
+     * */
     float tfar;
+
+    /**
+     * @brief Any change of the camera restarts the accumulation of samples. Since the runtime can't detect changes of
+     *        the scene, the frame callback should increment this after modifying the scene, to restart accumulation.
+     * */
+    uint32_t revision;
+  };
+
+  /**
+   * @brief Timing statistics of one render thread for one frame.
+   * */
+  struct raygun_thread_stats
+  {
+    /**
+     * @brief The time spent rendering tiles, in seconds.
+     * */
+    double busy_time;
+
+    /**
+     * @brief The time spent without work while other threads were still rendering, in seconds.
+     * */
+    double idle_time;
+
+    uint32_t tiles;
+
+    /**
+     * @brief The number of tiles that were taken from the queues of other threads.
+     * */
+    uint32_t steals;
+
+    /**
+     * @brief The NUMA node that the thread belongs to. Always zero unless @ref raygun_config::numa is enabled.
+     * */
+    uint32_t node;
+
+    /**
+     * @brief The number of tiles that belonged to another NUMA node, whose memory was therefore remote.
+     * */
+    uint32_t remote_tiles;
+  };
+
+  /**
+   * @brief Statistics of the render threads of one NUMA node for one frame. Comparing the tiles rendered per second of
+   *        busy time between nodes shows whether remote memory slows a node down.
+   * */
+  struct raygun_node_stats
+  {
+    uint32_t threads;
+
+    uint32_t tiles;
+
+    uint32_t remote_tiles;
+
+    /**
+     * @brief The sum of the busy times of the threads of the node, in seconds.
+     * */
+    double busy_time;
   };
 
+  /**
+   * @brief Timing statistics of one frame.
+   * */
+  struct raygun_frame_stats
+  {
+    uint32_t frame_index;
+
+    /**
+     * @brief The render resolution of this frame, which is less than the window size when the dynamic resolution
+     *        controller has scaled it down.
+     * */
+    uint32_t width;
+
+    uint32_t height;
+
+    /**
+     * @brief The number of samples traced for each pixel in this frame.
+     * */
+    uint32_t samples_per_pixel;
+
+    /**
+     * @brief The number of pixels that still need samples after this frame. Without adaptive sampling, this is the
+     *        number of pixels in the image.
+     * */
+    uint32_t active_pixels;
+
+    /**
+     * @brief The time from the start of tracing to the end of the last tile, in seconds.
+     * */
+    double render_time;
+
+    uint32_t num_threads;
+
+    const struct raygun_thread_stats* threads;
+
+    uint32_t num_nodes;
+
+    const struct raygun_node_stats* nodes;
+  };
+
+  /**
+   * @brief Timings of the stages that one frame goes through after it was rendered, measured on the thread that
+   *        presents it. OpenGL commands run asynchronously, so the time the GPU spends on the upload and the draw only
+   *        shows up in the swap time.
+   * */
+  struct raygun_present_stats
+  {
+    /**
+     * @brief The number of frames that were presented before this one.
+     * */
+    uint32_t present_index;
+
+    /**
+     * @brief The render resolution of the frame.
+     * */
+    uint32_t width;
+
+    uint32_t height;
+
+    /**
+     * @brief The time spent waiting for the frame to be rendered, in seconds. Without @ref
+     *        raygun_config::async_present, the frame is rendered beforehand, and this is only the time to take it.
+     * */
+    double acquire_time;
+
+    /**
+     * @brief The time spent converting the frame and queuing its copy into the color textures, in seconds.
+     * */
+    double upload_time;
+
+    /**
+     * @brief The time spent queuing the draw of the frame, in seconds.
+     * */
+    double draw_time;
+
+    /**
+     * @brief The time spent swapping the window's buffers, or without a window, waiting for the GPU to finish the
+     *        frame, in seconds.
+     * */
+    double swap_time;
+  };
+
+  /**
+   * @brief Per-thread state that is passed to the trace callbacks.
+   * */
+  struct raygun_context;
+
+  /**
+   * @brief Gets the index of the render thread that a context belongs to. Thread indices start at zero, are less than
+   *        @ref raygun_frame_stats::num_threads, and stay the same for as long as the program runs, so they can be used
+   *        to index per-thread data of the caller.
+   * */
+  uint32_t raygun_thread_index(const struct raygun_context* context);
+
+  /**
+   * @brief Allocates temporary memory from the scratch arena of a render thread. The memory is aligned to 64 bytes
+   *        and remains valid until the end of the frame, after which it is reused without being freed. Since each
+   *        thread has its own arena, this takes no locks, and once the arena has grown to the size a frame needs, it
+   *        doesn't touch the heap either.
+   *
+   * @return On success, a pointer to the memory. On failure, a null pointer.
+   * */
+  void* raygun_alloc(struct raygun_context* context, size_t size);
+
+  /**
+   * @brief Gets a sample value for the pixel of a ray, which can be used for Monte Carlo integration in the trace
+   *        callbacks.
+   *
+   * @details The values of one dimension are well distributed over the samples of a pixel, and, depending on the
+   *          sampler in @ref raygun_config::sampler, over neighboring pixels. Different dimensions are independent of
+   *          each other, so each random decision of a path should use its own dimension.
+   *
+   * @param ray_id The @p id field of a ray passed to the trace callback, which is the index of its pixel.
+   *
+   * @param dimension The sample dimension, starting at zero.
+   *
+   * @return A value in the interval [0, 1).
+   * */
+  float raygun_sample(const struct raygun_context* context, uint32_t ray_id, uint32_t dimension);
+
+  /**
+   * @brief Tests a batch of rays for occlusion, such as the shadow rays of a trace callback. The rays are traced with
+   *        one stream call, which stops at the first hit of each ray.
+   *
+   * @param rays The rays to test. Following Embree's convention, the @p tfar of each occluded ray is set to negative
+   *             infinity.
+   *
+   * @param occluded Assigned one bit per ray, which is set if the ray is occluded. Bit (i % 32) of element (i / 32)
+   *                 belongs to ray i, so this must hold (num_rays + 31) / 32 elements.
+   * */
+  void raygun_occluded(struct raygun_context* context, uint32_t num_rays, struct RTCRay* rays, uint32_t* occluded);
+
+  /**
+   * @brief Same as @ref raygun_occluded, but for ray packets in Embree's structure-of-arrays layout.
+   *
+   * @param n The number of rays per packet (4, 8 or 16).
+   *
+   * @param num_packets The number of packets pointed to by @p packets.
+   *
+   * @param occluded Assigned one bit per ray, where ray i is lane (i % n) of packet (i / n). Inactive lanes, which have
+   *                 a @p tnear greater than @p tfar, are never occluded.
+   * */
+  void raygun_occluded_packets(struct raygun_context* context,
+                               uint32_t n,
+                               uint32_t num_packets,
+                               struct RTCRayN* packets,
+                               uint32_t* occluded);
+
+  /**
+   * @brief Queues the next ray of a path, to be intersected and passed to @ref raygun_interface::shade in the next
+   *        bounce. Only valid inside of the shade callback.
+   *
+   * @param path The index of the path, as passed to the shade callback.
+   *
+   * @param ray The ray to trace. Its @p id is replaced with the ID of the path's camera ray, so that
+   *            @ref raygun_sample keeps drawing samples for the same pixel.
+   *
+   * @return Zero on success, or -1 if the path already emitted a ray in this bounce or the path index is out of range.
+   * */
+  int raygun_emit_ray(struct raygun_context* context, uint32_t path, const struct RTCRay* ray);
+
+  /**
+   * @brief Queues a shadow ray for a path. If nothing occludes the ray, the given color is added to the radiance of the
+   *        path. Only valid inside of the shade callback.
+   *
+   * @note Shadow rays are tested in batches, so the result is not known until after the shade callback returns.
+   *
+   * @note If the path index is out of range, the call is ignored.
+   * */
+  void raygun_emit_shadow_ray(struct raygun_context* context,
+                              uint32_t path,
+                              const struct RTCRay* ray,
+                              float r,
+                              float g,
+                              float b);
+
+  /**
+   * @brief Adds to the radiance of a path, such as the light emitted by a surface that it hit. Only valid inside of
+   *        the shade callback. If the path index is out of range, the call is ignored.
+   * */
+  void raygun_add_radiance(struct raygun_context* context, uint32_t path, float r, float g, float b);
+
+  /**
+   * @brief Gets the user state of a path, which is @ref raygun_config::path_state_size bytes large and persists
+   *        between bounces. The state is not initialized at the start of a path.
+   *
+   * @return A pointer to the state, or a null pointer if the state size is zero or the path index is out of range.
+   * */
+  void* raygun_path_state(struct raygun_context* context, uint32_t path);
+
   struct raygun_interface
   {
     void (*setup)(void* caller, RTCDevice device, RTCScene scene);
 
     void (*teardown)(void* caller, RTCDevice device, RTCScene scene);
 
+    /**
+     * @brief Called at the start of every frame, before any rays are traced. The camera may be modified here.
+     *
+     * @note Unless @ref raygun_config::async_present is zero, this, the trace callbacks and the stats callback are
+     *       called from the render thread, which runs alongside the thread that called @ref raygun_exec. The scene
+     *       may be edited here, since no rays are in flight.
+     * */
     void (*frame)(void* caller, RTCDevice device, RTCScene scene, struct raygun_camera* camera);
 
+    /**
+     * @brief Computes the color of rays that were intersected with the scene.
+     *
+     * @param context Used to draw sample values with @ref raygun_sample.
+     *
+     * @note At most one of the trace callbacks is used. The runtime picks the widest packet callback that the Embree
+     *       device supports natively, and otherwise falls back to this one.
+     * */
     void (*trace)(void* caller,
                   RTCScene scene,
+                  struct raygun_context* context,
                   uint32_t num_rays,
                   const struct RTCRayHit* ray,
                   float* r,
                   float* g,
                   float* b);
 
+    /**
+     * @brief Computes the color of ray packets, where each packet covers a block of neighboring pixels.
+     *
+     * @param num_rays The number of packets pointed to by @p ray. The color arrays hold four values per packet.
+     *
+     * @note Packet lanes that fall outside of the image have a @p tnear greater than @p tfar and never hit anything.
+     *       The colors written for those lanes are ignored.
+     * */
     void (*trace4)(void* caller,
                    RTCScene scene,
+                   struct raygun_context* context,
                    uint32_t num_rays,
                    const struct RTCRayHit4* ray,
                    float* r,
                    float* g,
                    float* b);
 
+    /**
+     * @brief Same as @ref raygun_interface::trace4, but with eight rays per packet.
+     * */
     void (*trace8)(void* caller,
                    RTCScene scene,
+                   struct raygun_context* context,
                    uint32_t num_rays,
                    const struct RTCRayHit8* ray,
                    float* r,
                    float* g,
                    float* b);
 
+    /**
+     * @brief Same as @ref raygun_interface::trace4, but with sixteen rays per packet.
+     * */
     void (*trace16)(void* caller,
                     RTCScene scene,
+                    struct raygun_context* context,
                     uint32_t num_rays,
                     const struct RTCRayHit16* ray,
                     float* r,
@@ -67,13 +361,325 @@ extern "C"
                     float* b);
 
     void (*error)(void* caller, const char* what);
+
+    /**
+     * @brief Receives the statistics of each frame after it has been rendered. May be a null pointer.
+     * */
+    void (*stats)(void* caller, const struct raygun_frame_stats* stats);
+
+    /**
+     * @brief Shades the hits of a bounce of the wavefront integrator. If this is not a null pointer, it is used
+     *        instead of the trace callbacks.
+     *
+     * @details The runtime starts one path per camera ray, and advances all paths of a tile together, one bounce at a
+     *          time. The rays of a bounce are intersected in one batch and passed here. Paths continue by emitting
+     *          their next ray with @ref raygun_emit_ray, and gather light with @ref raygun_emit_shadow_ray and
+     *          @ref raygun_add_radiance. A path ends when it doesn't emit another ray. Per-path data, such as the
+     *          throughput, can be kept with @ref raygun_path_state.
+     *
+     * @param depth The number of bounces before this one. Zero for camera rays.
+     *
+     * @param num_rays The number of rays in @p rays.
+     *
+     * @param paths The path index of each ray.
+     * */
+    void (*shade)(void* caller,
+                  RTCScene scene,
+                  struct raygun_context* context,
+                  uint32_t depth,
+                  uint32_t num_rays,
+                  const uint32_t* paths,
+                  const struct RTCRayHit* rays);
+
+    /**
+     * @brief Receives the timings of each frame after it has been presented. This is called by the thread that
+     *        presents frames, which is not the one that calls the other callbacks if @ref raygun_config::async_present
+     *        is enabled. May be a null pointer.
+     * */
+    void (*present_stats)(void* caller, const struct raygun_present_stats* stats);
+  };
+
+  /**
+   * @brief How the runtime hands rays over to Embree and the trace callbacks.
+   * */
+  enum raygun_trace_mode
+  {
+    /**
+     * @brief Each ray (or ray packet) is intersected and traced on its own.
+     * */
+    RAYGUN_TRACE_MODE_PACKET,
+
+    /**
+     * @brief Rays are intersected in batches with the stream functions of Embree, and each batch is passed to the trace
+     *        callback in a single call.
+     * */
+    RAYGUN_TRACE_MODE_STREAM
+  };
+
+  /**
+   * @brief The order in which the pixels inside of a tile are rendered.
+   * */
+  enum raygun_tile_order
+  {
+    RAYGUN_TILE_ORDER_ROWS,
+
+    RAYGUN_TILE_ORDER_MORTON,
+
+    RAYGUN_TILE_ORDER_HILBERT
+  };
+
+  /**
+   * @brief The sequence that sample values are drawn from, for the pixel jitter and @ref raygun_sample.
+   * */
+  enum raygun_sampler_type
+  {
+    /**
+     * @brief Independent random values.
+     * */
+    RAYGUN_SAMPLER_RANDOM,
+
+    /**
+     * @brief An Owen-scrambled Sobol sequence. This converges the fastest as frames accumulate.
+     * */
+    RAYGUN_SAMPLER_SOBOL,
+
+    /**
+     * @brief The R2 sequence, randomly shifted per pixel.
+     * */
+    RAYGUN_SAMPLER_R2,
+
+    /**
+     * @brief A tiled blue noise texture, which spreads the error of the first frames into high frequencies.
+     * */
+    RAYGUN_SAMPLER_BLUE_NOISE
+  };
+
+  /**
+   * @brief How the color of a frame is laid out in the textures that it is uploaded to.
+   * */
+  enum raygun_color_layout
+  {
+    /**
+     * @brief One single channel texture per color component.
+     * */
+    RAYGUN_COLOR_LAYOUT_PLANAR,
+
+    /**
+     * @brief One RGBA texture, which takes one upload and one texture fetch per pixel instead of three. The color
+     *        planes written by the trace callbacks are interleaved while the frame is uploaded.
+     * */
+    RAYGUN_COLOR_LAYOUT_INTERLEAVED
+  };
+
+  /**
+   * @brief Where frames are accumulated and prepared for display.
+   * */
+  enum raygun_resolve_mode
+  {
+    /**
+     * @brief The colors of each frame are uploaded in floating point, and accumulated by a shader.
+     * */
+    RAYGUN_RESOLVE_GPU,
+
+    /**
+     * @brief Frames are accumulated, tone mapped and quantized to 8-bit sRGB on the CPU, and only the 8-bit image is
+     *        uploaded. This uploads a fraction of the data and needs no floating point render targets, which suits
+     *        software OpenGL implementations.
+     * */
+    RAYGUN_RESOLVE_CPU
+  };
+
+  /**
+   * @brief Options that control how the runtime renders.
+   * */
+  struct raygun_config
+  {
+    /**
+     * @brief The configuration string passed to @p rtcNewDevice. May be a null pointer.
+     * */
+    const char* embree_config;
+
+    /**
+     * @brief How rays are handed to Embree. In the stream trace mode, each tile is traced as one batch.
+     * */
+    enum raygun_trace_mode trace_mode;
+
+    /**
+     * @brief The width and height of the screen tiles, in pixels. This is rounded up to a power of two and clamped
+     *        to 256, which keeps enough tiles in a frame for the render threads to balance their work.
+     * */
+    uint32_t tile_size;
+
+    enum raygun_tile_order tile_order;
+
+    enum raygun_sampler_type sampler;
+
+    /**
+     * @brief The number of samples traced for each pixel in every frame. The samples are averaged before the frame is
+     *        uploaded and accumulated, so the per-frame cost of the display is paid only once. If this is zero, the
+     *        number is chosen each frame so that rendering takes about @ref raygun_config::target_frame_time.
+     * */
+    uint32_t samples_per_frame;
+
+    /**
+     * @brief The render time per frame that the automatic sample count aims for, in seconds.
+     * */
+    double target_frame_time;
+
+    /**
+     * @brief Enables adaptive sampling if greater than zero. Pixels stop receiving samples once the estimated relative
+     *        error of their mean luminance falls below this value (for example, 0.01 for one percent), and the
+     *        displayed image is the mean of all samples of each pixel. The estimates are discarded whenever the camera
+     *        changes.
+     * */
+    float adaptive_threshold;
+
+    /**
+     * @brief Enables dynamic resolution if less than one. The render resolution is then scaled, down to this fraction
+     *        of the window size along each axis, so that rendering takes about @ref raygun_config::target_frame_time.
+     *        The image is upscaled to the window with a Catmull-Rom filter.
+     *
+     * @note When the sample count is chosen automatically as well, the resolution is reduced only once a single sample
+     *       per pixel no longer fits in the frame time.
+     * */
+    float min_resolution_scale;
+
+    /**
+     * @brief Enables progressive refinement if non-zero. After the camera changes, the first frame traces one pixel out
+     *        of every 4x4 block and the second one out of every 2x2 block, with the remaining pixels filled in from the
+     *        traced ones. Full resolution rendering continues from the third frame on.
+     * */
+    int progressive;
+
+    /**
+     * @brief The number of bytes of user state kept for each path of the wavefront integrator.
+     * */
+    uint32_t path_state_size;
+
+    /**
+     * @brief The initial size of the scratch arena of each render thread, in bytes. Arenas grow as needed, so this
+     *        only avoids the growth during the first frames.
+     * */
+    size_t arena_size;
+
+    /**
+     * @brief If non-zero, frames are traced on a render thread while the calling thread presents the latest complete
+     *        frame, so that tracing doesn't wait for texture uploads or the vertical sync of the display. If zero,
+     *        each frame is traced and presented in turn on the calling thread.
+     * */
+    int async_present;
+
+    /**
+     * @brief How frames are laid out in the textures that they are uploaded to. Defaults to
+     *        @ref RAYGUN_COLOR_LAYOUT_PLANAR. The interleaved layout needs fewer uploads and texture fetches, but each
+     *        pixel carries an unused alpha channel, so frames take a third more upload bandwidth.
+     * */
+    enum raygun_color_layout color_layout;
+
+    /**
+     * @brief If non-zero, frames are converted to half precision before they are uploaded, which halves the upload
+     *        bandwidth. Accumulation still happens in single precision.
+     * */
+    int half_float_upload;
+
+    /**
+     * @brief Where frames are accumulated. With @ref RAYGUN_RESOLVE_CPU, the color layout and upload precision above
+     *        are ignored.
+     * */
+    enum raygun_resolve_mode resolve_mode;
+
+    /**
+     * @brief The factor that accumulated colors are multiplied with before they are clamped to [0, 1] and encoded as
+     *        sRGB. Only used with @ref RAYGUN_RESOLVE_CPU.
+     * */
+    float exposure;
+
+    /**
+     * @brief If non-zero, the per-pixel buffers are backed by transparent huge pages where the system supports them,
+     *        and Embree is configured to use huge pages for its acceleration structures as well.
+     * */
+    int huge_pages;
+
+    /**
+     * @brief If non-zero, the runtime works with the NUMA topology of the machine. The render threads are pinned to
+     *        CPUs and split among the nodes, and so is the image, in bands of rows. The tiles of a band are queued for
+     *        the threads of its node, and the per-pixel memory of a band is moved to its node. When frames are
+     *        rendered on the calling thread, it and its OpenMP threads get their previous CPU affinity back before the
+     *        call returns.
+     * */
+    int numa;
   };
 
+  /**
+   * @brief Assigns the default values to a configuration.
+   * */
+  void raygun_config_init(struct raygun_config* config);
+
   void raygun_exec(void* caller_data,
                    const struct raygun_interface* interface,
                    const char* window_title,
                    const char* embree_config);
 
+  void raygun_exec_with_config(void* caller_data,
+                               const struct raygun_interface* interface,
+                               const char* window_title,
+                               const struct raygun_config* config);
+
+  /**
+   * @brief Renders without a window or a GPU. The same callbacks are called as by @ref raygun_exec, but the frames are
+   *        averaged into an image on the CPU instead of being presented. If the camera changes between frames, the
+   *        average starts over.
+   *
+   * @note This works when raygun is built without the OpenGL viewer, unlike @ref raygun_exec.
+   *
+   * @param image The average of the frames so far, with three interleaved values per pixel. The rows go from the bottom
+   *              of the image to the top. It is updated after every frame, so the frame callback can read it. The
+   *              previous contents are ignored.
+   *
+   * @param max_frames The number of frames to render, or zero for no limit.
+   *
+   * @param time_limit The time in seconds after which no more frames are started, or zero for no limit. A frame that
+   *                   was started before the limit runs to completion.
+   *
+   * @return The number of frames that were rendered, or -1 if there is no limit or the setup failed. Errors are also
+   *         passed to the error callback.
+   * */
+  int raygun_render_headless(void* caller_data,
+                             const struct raygun_interface* interface,
+                             const struct raygun_config* config,
+                             int width,
+                             int height,
+                             float* image,
+                             uint32_t max_frames,
+                             double time_limit);
+
+  /**
+   * @brief Runs the same pipeline as @ref raygun_exec, including the upload of frames and the shaders that draw them,
+   *        but with a surfaceless or pixel buffer EGL context instead of a window. This makes it possible to test and
+   *        benchmark the OpenGL path on machines without a display, such as with Mesa's llvmpipe. The timings of each
+   *        stage are passed to @ref raygun_interface::present_stats.
+   *
+   * @note This is only available if raygun was built with the EGL backend. Otherwise, it reports an error.
+   *
+   * @param pixels If not a null pointer, receives the last presented frame as 8-bit RGBA, with the rows going from the
+   *               bottom of the image to the top.
+   *
+   * @param max_frames The number of frames to present, or zero for no limit.
+   *
+   * @param time_limit The time in seconds after which no more frames are presented, or zero for no limit.
+   *
+   * @return The number of frames that were presented, or -1 if there is no limit or the setup failed. Errors are also
+   *         passed to the error callback.
+   * */
+  int raygun_exec_offscreen(void* caller_data,
+                            const struct raygun_interface* interface,
+                            const struct raygun_config* config,
+                            int width,
+                            int height,
+                            unsigned char* pixels,
+                            uint32_t max_frames,
+                            double time_limit);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
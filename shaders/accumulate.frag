@@ -1,22 +1,88 @@
 #version 300 es
 
+#ifdef INTERLEAVED_COLOR
+
+uniform sampler2D rgb_texture;
+
+#else
+
 uniform sampler2D r_texture;
 
 uniform sampler2D g_texture;
 
 uniform sampler2D b_texture;
 
+#endif
+
 uniform sampler2D previous;
 
+/* The part of the color textures that holds the rendered image, in texels. This is less than the size of the textures
+ * when rendering at a reduced resolution. */
+uniform ivec2 render_size;
+
 in highp vec2 texcoords;
 
 out highp vec4 hdr_output;
 
+highp vec4
+catmull_rom_weights(highp float t)
+{
+  highp float t2 = t * t;
+  highp float t3 = t2 * t;
+  return vec4(-0.5 * t3 + t2 - 0.5 * t,
+              1.5 * t3 - 2.5 * t2 + 1.0,
+              -1.5 * t3 + 2.0 * t2 + 0.5 * t,
+              0.5 * t3 - 0.5 * t2);
+}
+
+highp vec3
+fetch_color(ivec2 p)
+{
+  p = clamp(p, ivec2(0), render_size - 1);
+#ifdef INTERLEAVED_COLOR
+  return texelFetch(rgb_texture, p, 0).rgb;
+#else
+  return vec3(texelFetch(r_texture, p, 0).a, texelFetch(g_texture, p, 0).a, texelFetch(b_texture, p, 0).a);
+#endif
+}
+
+/* Upscales the rendered image to the output with a Catmull-Rom filter. The color textures are 32-bit float, which
+ * can't be filtered by the hardware in OpenGL ES, so the filter taps are fetched individually. At the same resolution,
+ * the filter reduces to reading the texel under the fragment. */
+highp vec3
+sample_color()
+{
+  highp vec2 p = texcoords * vec2(render_size) - 0.5;
+
+  highp vec2 base = floor(p);
+
+  highp vec2 f = p - base;
+
+  highp vec4 wx = catmull_rom_weights(f.x);
+  highp vec4 wy = catmull_rom_weights(f.y);
+
+  ivec2 origin = ivec2(base) - 1;
+
+  highp vec3 color = vec3(0.0);
+
+  for (int y = 0; y < 4; y++) {
+    highp vec3 row = vec3(0.0);
+    for (int x = 0; x < 4; x++) {
+      row += fetch_color(origin + ivec2(x, y)) * wx[x];
+    }
+    color += row * wy[y];
+  }
+
+  return max(color, vec3(0.0));
+}
+
 void
 main()
 {
-  highp float r = texture(r_texture, texcoords).a;
-  highp float g = texture(g_texture, texcoords).a;
-  highp float b = texture(b_texture, texcoords).a;
-  hdr_output = vec4(texture(previous, texcoords).rgb + vec3(r, g, b), 1.0);
+#ifdef RESOLVED_COLOR
+  /* The color was already accumulated, tone mapped and encoded on the CPU. */
+  hdr_output = vec4(min(sample_color(), vec3(1.0)), 1.0);
+#else
+  hdr_output = vec4(texture(previous, texcoords).rgb + sample_color(), 1.0);
+#endif
 }
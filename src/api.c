@@ -2,13 +2,53 @@
 
 #include "runtime.h"
 
+void
+raygun_config_init(struct raygun_config* config)
+{
+  config->embree_config = NULL;
+  config->trace_mode = RAYGUN_TRACE_MODE_PACKET;
+  config->tile_size = 16;
+  config->tile_order = RAYGUN_TILE_ORDER_MORTON;
+  config->sampler = RAYGUN_SAMPLER_SOBOL;
+  config->samples_per_frame = 1;
+  config->target_frame_time = 1.0 / 60.0;
+  config->adaptive_threshold = 0.0f;
+  config->min_resolution_scale = 1.0f;
+  config->progressive = 0;
+  config->path_state_size = 0;
+  config->arena_size = 1024 * 1024;
+  config->async_present = 1;
+  config->color_layout = RAYGUN_COLOR_LAYOUT_PLANAR;
+  config->half_float_upload = 0;
+  config->resolve_mode = RAYGUN_RESOLVE_GPU;
+  config->exposure = 1.0f;
+  config->huge_pages = 0;
+  config->numa = 0;
+}
+
 void
 raygun_exec(void* caller_data,
             const struct raygun_interface* interface,
             const char* window_title,
             const char* embree_config)
 {
-  struct rg_runtime* rt = rg_runtime_new(caller_data, interface, window_title, embree_config);
+  struct raygun_config config;
+
+  raygun_config_init(&config);
+
+  config.embree_config = embree_config;
+
+  raygun_exec_with_config(caller_data, interface, window_title, &config);
+}
+
+void
+raygun_exec_with_config(void* caller_data,
+                        const struct raygun_interface* interface,
+                        const char* window_title,
+                        const struct raygun_config* config)
+{
+#ifdef RAYGUN_GL
+  struct rg_runtime* rt = rg_runtime_new(caller_data, interface, window_title, config);
   if (!rt) {
     return;
   }
@@ -21,4 +61,95 @@ raygun_exec(void* caller_data,
   }
 
   rg_runtime_delete(rt);
+#else
+  (void)window_title;
+  (void)config;
+
+  if (interface->error) {
+    interface->error(caller_data, "This build of raygun has no OpenGL viewer. Use headless rendering instead.");
+  }
+#endif
+}
+
+int
+raygun_render_headless(void* caller_data,
+                       const struct raygun_interface* interface,
+                       const struct raygun_config* config,
+                       const int width,
+                       const int height,
+                       float* image,
+                       const uint32_t max_frames,
+                       const double time_limit)
+{
+  if ((max_frames == 0) && (time_limit <= 0.0)) {
+    if (interface->error) {
+      interface->error(caller_data, "Headless rendering needs a frame count or a time limit.");
+    }
+    return -1;
+  }
+
+  if ((width < 1) || (height < 1) || !image) {
+    if (interface->error) {
+      interface->error(caller_data, "Headless rendering needs an image of at least one pixel.");
+    }
+    return -1;
+  }
+
+  struct rg_runtime* rt = rg_runtime_new_headless(caller_data, interface, config, width, height, image);
+  if (!rt) {
+    return -1;
+  }
+
+  const uint32_t frames = rg_runtime_run_headless(rt, max_frames, time_limit);
+
+  rg_runtime_delete(rt);
+
+  return (int)frames;
+}
+
+int
+raygun_exec_offscreen(void* caller_data,
+                      const struct raygun_interface* interface,
+                      const struct raygun_config* config,
+                      const int width,
+                      const int height,
+                      unsigned char* pixels,
+                      const uint32_t max_frames,
+                      const double time_limit)
+{
+  if ((max_frames == 0) && (time_limit <= 0.0)) {
+    if (interface->error) {
+      interface->error(caller_data, "Offscreen rendering needs a frame count or a time limit.");
+    }
+    return -1;
+  }
+
+  if ((width < 1) || (height < 1)) {
+    if (interface->error) {
+      interface->error(caller_data, "Offscreen rendering needs an image of at least one pixel.");
+    }
+    return -1;
+  }
+
+#ifdef RAYGUN_EGL
+  struct rg_runtime* rt = rg_runtime_new_offscreen(caller_data, interface, config, width, height);
+  if (!rt) {
+    return -1;
+  }
+
+  const uint32_t frames = rg_runtime_run_offscreen(rt, max_frames, time_limit, pixels);
+
+  rg_runtime_delete(rt);
+
+  return (int)frames;
+#else
+  (void)config;
+  (void)pixels;
+
+  if (interface->error) {
+    interface->error(caller_data, "This build of raygun has no EGL backend.");
+  }
+
+  return -1;
+#endif
 }
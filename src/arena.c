@@ -0,0 +1,142 @@
+#include "arena.h"
+
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The largest number of blocks that an arena grows to within one frame.
+ * */
+#define MAX_BLOCKS 32
+
+struct rg_arena
+{
+  unsigned char* blocks[MAX_BLOCKS];
+
+  size_t sizes[MAX_BLOCKS];
+
+  int num_blocks;
+
+  /**
+   * @brief The index of the block that allocations are currently taken from.
+   * */
+  int current;
+
+  /**
+   * @brief The number of bytes used in the current block.
+   * */
+  size_t offset;
+
+  size_t block_size;
+};
+
+struct rg_arena*
+rg_arena_new(const size_t block_size)
+{
+  struct rg_arena* self = malloc(sizeof(struct rg_arena));
+  if (!self) {
+    return NULL;
+  }
+
+  memset(self, 0, sizeof(struct rg_arena));
+
+  self->block_size = (block_size > 0) ? block_size : 4096;
+
+  return self;
+}
+
+static void
+free_blocks(struct rg_arena* self)
+{
+  for (int i = 0; i < self->num_blocks; i++) {
+    rg_aligned_free(self->blocks[i]);
+  }
+
+  self->num_blocks = 0;
+  self->current = 0;
+  self->offset = 0;
+}
+
+void
+rg_arena_delete(struct rg_arena* self)
+{
+  if (self) {
+    free_blocks(self);
+  }
+
+  free(self);
+}
+
+static int
+add_block(struct rg_arena* self, const size_t min_size)
+{
+  if (self->num_blocks == MAX_BLOCKS) {
+    return -1;
+  }
+
+  const size_t size = (min_size > self->block_size) ? min_size : self->block_size;
+
+  unsigned char* block = rg_aligned_malloc(64, size);
+  if (!block) {
+    return -1;
+  }
+
+  self->blocks[self->num_blocks] = block;
+  self->sizes[self->num_blocks] = size;
+  self->num_blocks++;
+
+  return 0;
+}
+
+void*
+rg_arena_alloc(struct rg_arena* self, const size_t size, const size_t alignment)
+{
+  for (;;) {
+
+    if (self->current < self->num_blocks) {
+
+      const size_t offset = (self->offset + alignment - 1) & ~(alignment - 1);
+
+      if ((offset <= self->sizes[self->current]) && (size <= (self->sizes[self->current] - offset))) {
+        self->offset = offset + size;
+        return self->blocks[self->current] + offset;
+      }
+
+      if ((self->current + 1) < self->num_blocks) {
+        self->current++;
+        self->offset = 0;
+        continue;
+      }
+    }
+
+    /* Blocks are 64-byte aligned, so the allocation fits at the start of a new block of this size. */
+
+    if (add_block(self, size) != 0) {
+      return NULL;
+    }
+
+    self->current = self->num_blocks - 1;
+    self->offset = 0;
+  }
+}
+
+void
+rg_arena_reset(struct rg_arena* self)
+{
+  if (self->num_blocks > 1) {
+
+    size_t total = 0;
+
+    for (int i = 0; i < self->num_blocks; i++) {
+      total += self->sizes[i];
+    }
+
+    free_blocks(self);
+
+    self->block_size = total;
+  }
+
+  self->current = 0;
+  self->offset = 0;
+}
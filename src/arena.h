@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief A bump allocator for temporary memory, owned by a single thread.
+ *
+ * @details Allocations are carved out of large blocks and are never freed individually. Instead, the whole arena is
+ *          reset at once, which makes all of its memory available again. When a block runs out, another one is added,
+ *          and the next reset merges the blocks into one, so that an arena settles on a single block of the size that
+ *          a frame needs.
+ * */
+struct rg_arena;
+
+/**
+ * @brief Creates a new arena.
+ *
+ * @param block_size The size of the first block, in bytes. The block is allocated on first use.
+ *
+ * @return On success, a pointer to the arena. On failure, a null pointer.
+ * */
+struct rg_arena*
+rg_arena_new(size_t block_size);
+
+void
+rg_arena_delete(struct rg_arena* self);
+
+/**
+ * @brief Allocates memory from the arena. The memory remains valid until the arena is reset.
+ *
+ * @param alignment The alignment of the memory, in bytes. Must be a power of two, and no more than 64.
+ *
+ * @return On success, a pointer to the memory. On failure, a null pointer.
+ * */
+void*
+rg_arena_alloc(struct rg_arena* self, size_t size, size_t alignment);
+
+/**
+ * @brief Releases all allocations of the arena at once.
+ * */
+void
+rg_arena_reset(struct rg_arena* self);
@@ -0,0 +1,76 @@
+#include "camera.h"
+
+#include <math.h>
+
+static float
+length(const float* v)
+{
+  return sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+static void
+cross(const float* a, const float* b, float* out)
+{
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static int
+normalize(float* v)
+{
+  const float l = length(v);
+  if (l <= 0.0f) {
+    return -1;
+  }
+
+  v[0] /= l;
+  v[1] /= l;
+  v[2] /= l;
+
+  return 0;
+}
+
+void
+rg_camera_setup(struct rg_camera* self, const struct raygun_camera* camera, const int w, const int h)
+{
+  float forward[3] = { camera->dir[0], camera->dir[1], camera->dir[2] };
+
+  if (normalize(forward) != 0) {
+    forward[0] = 0.0f;
+    forward[1] = 0.0f;
+    forward[2] = -1.0f;
+  }
+
+  /* The world up vector is +Y, unless the camera looks straight up or down. */
+
+  float up_hint[3] = { 0.0f, 1.0f, 0.0f };
+
+  float right[3];
+
+  cross(forward, up_hint, right);
+
+  if (normalize(right) != 0) {
+    up_hint[1] = 0.0f;
+    up_hint[2] = -1.0f;
+    cross(forward, up_hint, right);
+    normalize(right);
+  }
+
+  float up[3];
+
+  cross(right, forward, up);
+
+  const float x_scale = 2.0f / (float)w;
+  const float y_scale = 2.0f / (float)h;
+
+  for (int i = 0; i < 3; i++) {
+    self->org[i] = camera->pos[i];
+    self->base[i] = forward[i] - right[i] - up[i];
+    self->step_x[i] = right[i] * x_scale;
+    self->step_y[i] = up[i] * y_scale;
+  }
+
+  self->tnear = camera->tnear;
+  self->tfar = camera->tfar;
+}
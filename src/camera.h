@@ -0,0 +1,65 @@
+#pragma once
+
+#include <raygun.h>
+
+#include <math.h>
+
+/**
+ * @brief The camera of a frame, reduced to what is needed to generate primary rays.
+ *
+ * @details The direction of the ray through pixel coordinates (px, py) is base + px * step_x + py * step_y, normalized.
+ *          The image plane spans [-1, 1] along both the right and up vectors of the camera, at a distance of one unit
+ *          along the view direction.
+ * */
+struct rg_camera
+{
+  float org[3];
+
+  /**
+   * @brief The (unnormalized) direction through the lower left corner of the image.
+   * */
+  float base[3];
+
+  /**
+   * @brief The change in direction from one column of pixels to the next.
+   * */
+  float step_x[3];
+
+  /**
+   * @brief The change in direction from one row of pixels to the next.
+   * */
+  float step_y[3];
+
+  float tnear;
+
+  float tfar;
+};
+
+/**
+ * @brief Computes the basis of the camera for an image of the given size.
+ * */
+void
+rg_camera_setup(struct rg_camera* self, const struct raygun_camera* camera, int w, int h);
+
+/**
+ * @brief Computes the normalized ray direction for a pixel coordinate.
+ *
+ * @param px The horizontal pixel coordinate, which includes the sub-pixel offset.
+ *
+ * @param py The vertical pixel coordinate, which includes the sub-pixel offset.
+ *
+ * @note This is meant to be inlined into the vectorized ray generation loops.
+ * */
+static inline void
+rg_camera_direction(const struct rg_camera* self, const float px, const float py, float* dx, float* dy, float* dz)
+{
+  const float x = self->base[0] + px * self->step_x[0] + py * self->step_y[0];
+  const float y = self->base[1] + px * self->step_x[1] + py * self->step_y[1];
+  const float z = self->base[2] + px * self->step_x[2] + py * self->step_y[2];
+
+  const float rcp_mag = 1.0f / sqrtf(x * x + y * y + z * z);
+
+  *dx = x * rcp_mag;
+  *dy = y * rcp_mag;
+  *dz = z * rcp_mag;
+}
@@ -0,0 +1,171 @@
+#include "context.h"
+
+#include "arena.h"
+#include "packet.h"
+
+#include <math.h>
+
+uint32_t
+raygun_thread_index(const struct raygun_context* context)
+{
+  return context->thread_index;
+}
+
+void*
+raygun_alloc(struct raygun_context* context, const size_t size)
+{
+  return rg_arena_alloc(context->arena, size, 64);
+}
+
+float
+raygun_sample(const struct raygun_context* context, const uint32_t ray_id, const uint32_t dimension)
+{
+  const int width = (context->width > 0) ? context->width : 1;
+
+  const int x = (int)(ray_id % (uint32_t)width);
+  const int y = (int)(ray_id / (uint32_t)width);
+
+  return rg_sampler_get(context->sampler, x, y, width, context->sample_index, dimension + RG_SAMPLE_DIM_USER);
+}
+
+/**
+ * @brief Gathers the occlusion results of a batch into a bitmask.
+ *
+ * @param tfar The @p tfar value of each ray, which Embree sets to negative infinity for occluded rays.
+ *
+ * @param stride The distance between consecutive @p tfar values, in floats.
+ * */
+static void
+gather_occlusion_mask(const float* tfar, const size_t stride, const uint32_t num_rays, uint32_t* occluded)
+{
+  for (uint32_t first = 0; first < num_rays; first += 32) {
+
+    const uint32_t count = ((num_rays - first) < 32) ? (num_rays - first) : 32;
+
+    uint32_t mask = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+      mask |= ((uint32_t)(tfar[(first + i) * stride] == -INFINITY)) << i;
+    }
+
+    occluded[first / 32] = mask;
+  }
+}
+
+void
+raygun_occluded(struct raygun_context* context, const uint32_t num_rays, struct RTCRay* rays, uint32_t* occluded)
+{
+  struct RTCIntersectContext intersect_context;
+
+  rtcInitIntersectContext(&intersect_context);
+
+  intersect_context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+  rtcOccluded1M(context->scene, &intersect_context, rays, num_rays, sizeof(struct RTCRay));
+
+  gather_occlusion_mask(&rays->tfar, sizeof(struct RTCRay) / sizeof(float), num_rays, occluded);
+}
+
+void
+raygun_occluded_packets(struct raygun_context* context,
+                        const uint32_t n,
+                        const uint32_t num_packets,
+                        struct RTCRayN* packets,
+                        uint32_t* occluded)
+{
+  struct RTCIntersectContext intersect_context;
+
+  rtcInitIntersectContext(&intersect_context);
+
+  intersect_context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+  /* A packet of rays has the same layout as the ray half of a packet of ray hits, which ends with the flags. */
+
+  const size_t packet_bytes = sizeof(float) * n * (RG_PACKET_FLAGS + 1u);
+
+  /* Inactive lanes may already have a tfar of negative infinity, like the lanes that raygen marks as being outside of
+   * the image, so they are recorded in the mask before tracing and cleared from it afterwards. Packets hold fewer
+   * than 32 rays, so they share the words of the mask. */
+
+  for (uint32_t i = 0; i < num_packets; i++) {
+
+    const float* ray_data = (const float*)(((const char*)packets) + packet_bytes * i);
+
+    const float* tnear = ray_data + n * RG_PACKET_TNEAR;
+    const float* tfar = ray_data + n * RG_PACKET_TFAR;
+
+    for (uint32_t lane = 0; lane < n; lane++) {
+
+      const uint32_t ray = i * n + lane;
+
+      const uint32_t bit = 1u << (ray % 32);
+
+      if (tnear[lane] > tfar[lane]) {
+        occluded[ray / 32] |= bit;
+      } else {
+        occluded[ray / 32] &= ~bit;
+      }
+    }
+  }
+
+  rtcOccludedNM(context->scene, &intersect_context, packets, n, num_packets, packet_bytes);
+
+  for (uint32_t i = 0; i < num_packets; i++) {
+
+    const float* tfar = ((const float*)(((const char*)packets) + packet_bytes * i)) + n * RG_PACKET_TFAR;
+
+    for (uint32_t lane = 0; lane < n; lane++) {
+
+      const uint32_t ray = i * n + lane;
+
+      const uint32_t bit = 1u << (ray % 32);
+
+      if ((occluded[ray / 32] & bit) || (tfar[lane] != -INFINITY)) {
+        occluded[ray / 32] &= ~bit;
+      } else {
+        occluded[ray / 32] |= bit;
+      }
+    }
+  }
+}
+
+int
+raygun_emit_ray(struct raygun_context* context, const uint32_t path, const struct RTCRay* ray)
+{
+  if (!context->wavefront) {
+    return -1;
+  }
+
+  return rg_wavefront_emit(context->wavefront, path, ray);
+}
+
+void
+raygun_emit_shadow_ray(struct raygun_context* context,
+                       const uint32_t path,
+                       const struct RTCRay* ray,
+                       const float r,
+                       const float g,
+                       const float b)
+{
+  if (context->wavefront) {
+    rg_wavefront_emit_shadow(context->wavefront, path, ray, r, g, b);
+  }
+}
+
+void
+raygun_add_radiance(struct raygun_context* context, const uint32_t path, const float r, const float g, const float b)
+{
+  if (context->wavefront) {
+    rg_wavefront_add(context->wavefront, path, r, g, b);
+  }
+}
+
+void*
+raygun_path_state(struct raygun_context* context, const uint32_t path)
+{
+  if (!context->wavefront) {
+    return NULL;
+  }
+
+  return rg_wavefront_state(context->wavefront, path);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <raygun.h>
+
+#include "arena.h"
+#include "sampler.h"
+#include "wavefront.h"
+
+#include <stdint.h>
+
+/**
+ * @brief The state behind the context handle that is passed to the trace callbacks. Each render thread has its own.
+ * */
+struct raygun_context
+{
+  RTCScene scene;
+
+  const struct rg_sampler* sampler;
+
+  /**
+   * @brief The index of the pixel sample being traced.
+   * */
+  uint32_t sample_index;
+
+  /**
+   * @brief The width of the image, in pixels. Used to map ray IDs back to pixel coordinates.
+   * */
+  int width;
+
+  /**
+   * @brief The ray queues of the thread, or a null pointer if the wavefront integrator isn't used.
+   * */
+  struct rg_wavefront* wavefront;
+
+  /**
+   * @brief The scratch memory of the thread, which is reset at the start of each frame.
+   * */
+  struct rg_arena* arena;
+
+  uint32_t thread_index;
+};
@@ -0,0 +1,180 @@
+#include "convert.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__F16C__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief The number of pixels that are interleaved at a time before being converted to half precision.
+ * */
+#define BLOCK_SIZE 256
+
+void
+rg_interleave_rgba32f(const float* restrict planes, const size_t n, float* restrict rgba)
+{
+  const float* restrict r = planes;
+  const float* restrict g = r + n;
+  const float* restrict b = g + n;
+
+#pragma omp simd
+  for (size_t i = 0; i < n; i++) {
+    rgba[i * 4 + 0] = r[i];
+    rgba[i * 4 + 1] = g[i];
+    rgba[i * 4 + 2] = b[i];
+    rgba[i * 4 + 3] = 1.0f;
+  }
+}
+
+static uint16_t
+float_to_half(const float value)
+{
+  uint32_t x = 0;
+
+  memcpy(&x, &value, sizeof(x));
+
+  const uint32_t sign = (x >> 16) & 0x8000u;
+
+  x &= 0x7fffffffu;
+
+  if (x >= 0x7f800000u) {
+    /* Infinity stays infinity, and NaN stays NaN. */
+    return (uint16_t)(sign | 0x7c00u | ((x > 0x7f800000u) ? 0x200u : 0u));
+  }
+
+  if (x >= 0x477ff000u) {
+    /* Rounds to a value above the largest finite half, 65504. */
+    return (uint16_t)(sign | 0x7c00u);
+  }
+
+  if (x < 0x38800000u) {
+
+    /* Below the smallest normal half, 2^-14, the value becomes a subnormal half (or zero). */
+
+    if (x < 0x33000000u) {
+      return (uint16_t)sign;
+    }
+
+    const uint32_t exponent = x >> 23;
+
+    const uint32_t mantissa = (x & 0x7fffffu) | 0x800000u;
+
+    const uint32_t shift = 126u - exponent;
+
+    uint32_t h = mantissa >> shift;
+
+    const uint32_t rest = mantissa & ((1u << shift) - 1u);
+
+    const uint32_t halfway = 1u << (shift - 1u);
+
+    h += (uint32_t)((rest > halfway) || ((rest == halfway) && (h & 1u)));
+
+    return (uint16_t)(sign | h);
+  }
+
+  /* Rebias the exponent from 127 to 15, then round away the lower 13 bits of the mantissa to the nearest even. A carry
+   * out of the mantissa correctly moves on to the next exponent. */
+
+  uint32_t h = x - 0x38000000u;
+
+  const uint32_t rest = h & 0x1fffu;
+
+  h >>= 13;
+
+  h += (uint32_t)((rest > 0x1000u) || ((rest == 0x1000u) && (h & 1u)));
+
+  return (uint16_t)(sign | h);
+}
+
+void
+rg_convert_f16(const float* restrict values, const size_t n, uint16_t* restrict halfs)
+{
+  size_t i = 0;
+
+#if defined(__AVX512F__)
+  for (; (i + 16) <= n; i += 16) {
+    const __m512 v = _mm512_loadu_ps(values + i);
+    _mm256_storeu_si256((__m256i*)(halfs + i), _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+  }
+#endif
+
+#if defined(__F16C__)
+  for (; (i + 8) <= n; i += 8) {
+    const __m256 v = _mm256_loadu_ps(values + i);
+    _mm_storeu_si128((__m128i*)(halfs + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+  }
+#endif
+
+  for (; i < n; i++) {
+    halfs[i] = float_to_half(values[i]);
+  }
+}
+
+void
+rg_interleave_rgba16f(const float* planes, const size_t n, uint16_t* rgba)
+{
+  float block[BLOCK_SIZE * 4];
+
+  for (size_t first = 0; first < n; first += BLOCK_SIZE) {
+
+    const size_t count = ((n - first) < BLOCK_SIZE) ? (n - first) : BLOCK_SIZE;
+
+    const float* r = planes + first;
+    const float* g = r + n;
+    const float* b = g + n;
+
+#pragma omp simd
+    for (size_t i = 0; i < count; i++) {
+      block[i * 4 + 0] = r[i];
+      block[i * 4 + 1] = g[i];
+      block[i * 4 + 2] = b[i];
+      block[i * 4 + 3] = 1.0f;
+    }
+
+    rg_convert_f16(block, count * 4, rgba + first * 4);
+  }
+}
+
+void
+rg_srgb_lut_init(unsigned char* lut)
+{
+  for (int i = 0; i < RG_SRGB_LUT_SIZE; i++) {
+
+    const double x = ((double)i) / ((double)(RG_SRGB_LUT_SIZE - 1));
+
+    const double y = (x <= 0.0031308) ? (x * 12.92) : (1.055 * pow(x, 1.0 / 2.4) - 0.055);
+
+    lut[i] = (unsigned char)(y * 255.0 + 0.5);
+  }
+}
+
+static inline int
+lut_index(const float value, const float scale)
+{
+  float x = value * scale;
+
+  x = (x > 0.0f) ? x : 0.0f;
+  x = (x < 1.0f) ? x : 1.0f;
+
+  return (int)(x * (float)(RG_SRGB_LUT_SIZE - 1) + 0.5f);
+}
+
+void
+rg_tonemap_rgba8(const float* restrict r,
+                 const float* restrict g,
+                 const float* restrict b,
+                 const size_t n,
+                 const float scale,
+                 const unsigned char* restrict lut,
+                 unsigned char* restrict rgba)
+{
+#pragma omp simd
+  for (size_t i = 0; i < n; i++) {
+    rgba[i * 4 + 0] = lut[lut_index(r[i], scale)];
+    rgba[i * 4 + 1] = lut[lut_index(g[i], scale)];
+    rgba[i * 4 + 2] = lut[lut_index(b[i], scale)];
+    rgba[i * 4 + 3] = 255;
+  }
+}
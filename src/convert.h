@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Interleaves three color planes into RGBA pixels, with an alpha of one.
+ *
+ * @param planes The red, green and blue planes, one after another, with @p n values each.
+ *
+ * @param n The number of pixels.
+ * */
+void
+rg_interleave_rgba32f(const float* planes, size_t n, float* rgba);
+
+/**
+ * @brief Same as @ref rg_interleave_rgba32f, but converts the values to half precision.
+ * */
+void
+rg_interleave_rgba16f(const float* planes, size_t n, uint16_t* rgba);
+
+/**
+ * @brief Converts values to half precision, rounding to the nearest value. Values that are too large for half
+ *        precision become infinite.
+ * */
+void
+rg_convert_f16(const float* values, size_t n, uint16_t* halfs);
+
+/**
+ * @brief The number of entries of the table that maps linear values in [0, 1] to 8-bit sRGB.
+ * */
+#define RG_SRGB_LUT_SIZE 4096
+
+/**
+ * @brief Fills the table that maps linear values to 8-bit sRGB, which has @ref RG_SRGB_LUT_SIZE entries.
+ * */
+void
+rg_srgb_lut_init(unsigned char* lut);
+
+/**
+ * @brief Scales linear colors, clamps them to [0, 1] and quantizes them to 8-bit sRGB, with an alpha of 255.
+ *
+ * @param n The number of pixels in each of the color arrays.
+ *
+ * @param scale The factor that the colors are multiplied with before they are clamped.
+ *
+ * @param lut The table filled by @ref rg_srgb_lut_init.
+ *
+ * @param rgba Assigned four bytes per pixel.
+ * */
+void
+rg_tonemap_rgba8(const float* r,
+                 const float* g,
+                 const float* b,
+                 size_t n,
+                 float scale,
+                 const unsigned char* lut,
+                 unsigned char* rgba);
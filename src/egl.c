@@ -0,0 +1,201 @@
+#include "egl.h"
+
+#include <glad/glad.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+struct rg_egl
+{
+  EGLDisplay display;
+
+  /**
+   * @brief The pixel buffer that the context is current with, or no surface if the context is surfaceless.
+   * */
+  EGLSurface surface;
+
+  EGLContext context;
+
+  int initialized;
+};
+
+/**
+ * @brief Whether a space separated list of extensions contains an extension. Prefixes of other names don't count.
+ * */
+static int
+has_extension(const char* extensions, const char* name)
+{
+  if (!extensions) {
+    return 0;
+  }
+
+  const size_t length = strlen(name);
+
+  const char* p = extensions;
+
+  while ((p = strstr(p, name)) != NULL) {
+
+    const int starts = (p == extensions) || (p[-1] == ' ');
+    const int ends = (p[length] == ' ') || (p[length] == 0);
+
+    if (starts && ends) {
+      return 1;
+    }
+
+    p += length;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Opens the surfaceless platform if the client library offers it, and the default display otherwise.
+ * */
+static EGLDisplay
+open_display(void)
+{
+  const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+  if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless") &&
+      has_extension(client_extensions, "EGL_EXT_platform_base")) {
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (get_platform_display) {
+
+      EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+      if (display != EGL_NO_DISPLAY) {
+        return display;
+      }
+    }
+  }
+
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+struct rg_egl*
+rg_egl_new(void)
+{
+  struct rg_egl* self = malloc(sizeof(struct rg_egl));
+  if (!self) {
+    return NULL;
+  }
+
+  memset(self, 0, sizeof(struct rg_egl));
+
+  self->display = EGL_NO_DISPLAY;
+  self->surface = EGL_NO_SURFACE;
+  self->context = EGL_NO_CONTEXT;
+
+  self->display = open_display();
+  if (self->display == EGL_NO_DISPLAY) {
+    rg_egl_delete(self);
+    return NULL;
+  }
+
+  EGLint major = 0;
+  EGLint minor = 0;
+
+  if (eglInitialize(self->display, &major, &minor) != EGL_TRUE) {
+    rg_egl_delete(self);
+    return NULL;
+  }
+
+  self->initialized = 1;
+
+  if (eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE) {
+    rg_egl_delete(self);
+    return NULL;
+  }
+
+  const int surfaceless = has_extension(eglQueryString(self->display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+  const EGLint config_attribs[] = { EGL_SURFACE_TYPE,
+                                    surfaceless ? 0 : EGL_PBUFFER_BIT,
+                                    EGL_RENDERABLE_TYPE,
+                                    EGL_OPENGL_ES3_BIT,
+                                    EGL_RED_SIZE,
+                                    8,
+                                    EGL_GREEN_SIZE,
+                                    8,
+                                    EGL_BLUE_SIZE,
+                                    8,
+                                    EGL_NONE };
+
+  EGLConfig config = NULL;
+
+  EGLint num_configs = 0;
+
+  if ((eglChooseConfig(self->display, config_attribs, &config, 1, &num_configs) != EGL_TRUE) || (num_configs < 1)) {
+    rg_egl_delete(self);
+    return NULL;
+  }
+
+  const EGLint context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+
+  self->context = eglCreateContext(self->display, config, EGL_NO_CONTEXT, context_attribs);
+  if (self->context == EGL_NO_CONTEXT) {
+    rg_egl_delete(self);
+    return NULL;
+  }
+
+  if (!surfaceless) {
+
+    /* The surface is never drawn to, it only has to exist for the context to be made current. */
+
+    const EGLint surface_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+
+    self->surface = eglCreatePbufferSurface(self->display, config, surface_attribs);
+    if (self->surface == EGL_NO_SURFACE) {
+      rg_egl_delete(self);
+      return NULL;
+    }
+  }
+
+  if (eglMakeCurrent(self->display, self->surface, self->surface, self->context) != EGL_TRUE) {
+    rg_egl_delete(self);
+    return NULL;
+  }
+
+  if (!gladLoadGLES2Loader((GLADloadproc)eglGetProcAddress)) {
+    rg_egl_delete(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void
+rg_egl_delete(struct rg_egl* self)
+{
+  if (self) {
+
+    if (self->initialized) {
+
+      eglMakeCurrent(self->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+      if (self->surface != EGL_NO_SURFACE) {
+        eglDestroySurface(self->display, self->surface);
+      }
+
+      if (self->context != EGL_NO_CONTEXT) {
+        eglDestroyContext(self->display, self->context);
+      }
+
+      eglTerminate(self->display);
+    }
+  }
+
+  free(self);
+}
+
+int
+rg_egl_is_surfaceless(const struct rg_egl* self)
+{
+  return self->surface == EGL_NO_SURFACE;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+/**
+ * @brief An OpenGL ES 3.0 context without a window, for presenting frames on machines without a display, such as with
+ *        Mesa's llvmpipe.
+ *
+ * @details Where EGL supports the surfaceless platform and surfaceless contexts, the context is made current without
+ *          a surface. Otherwise, it falls back to the default display and a tiny pixel buffer surface. Either way,
+ *          nothing should be drawn to the default framebuffer, so frames are drawn into a framebuffer object instead.
+ * */
+struct rg_egl;
+
+/**
+ * @brief Creates the context, makes it current on the calling thread and loads the OpenGL functions.
+ *
+ * @return On success, a pointer to the context. On failure, a null pointer.
+ * */
+struct rg_egl*
+rg_egl_new(void);
+
+void
+rg_egl_delete(struct rg_egl* self);
+
+/**
+ * @brief Whether the context is current without any surface.
+ * */
+int
+rg_egl_is_surfaceless(const struct rg_egl* self);
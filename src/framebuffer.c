@@ -12,6 +12,12 @@ struct rg_framebuffer
 
 struct rg_framebuffer*
 rg_framebuffer_new(int w, int h)
+{
+  return rg_framebuffer_new_with_format(w, h, GL_RGBA32F, GL_RGBA, GL_FLOAT);
+}
+
+struct rg_framebuffer*
+rg_framebuffer_new_with_format(int w, int h, GLenum internal_format, GLenum format, GLenum type)
 {
   struct rg_framebuffer* self = malloc(sizeof(struct rg_framebuffer));
   if (!self) {
@@ -30,7 +36,7 @@ rg_framebuffer_new(int w, int h)
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (GLsizei)w, (GLsizei)h, 0, GL_RGBA, GL_FLOAT, NULL);
+  glTexImage2D(GL_TEXTURE_2D, 0, (GLint)internal_format, (GLsizei)w, (GLsizei)h, 0, format, type, NULL);
 
   glGenFramebuffers(1, &self->id);
 
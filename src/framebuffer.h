@@ -4,9 +4,24 @@
 
 struct rg_framebuffer;
 
+/**
+ * @brief Creates a framebuffer with a 32-bit float RGBA texture.
+ * */
 struct rg_framebuffer*
 rg_framebuffer_new(int w, int h);
 
+/**
+ * @brief Creates a framebuffer with a texture of the given format.
+ *
+ * @param internal_format The sized format of the texture, such as GL_RGBA8.
+ *
+ * @param format The format of the pixels passed to glTexImage2D for the sized format, such as GL_RGBA.
+ *
+ * @param type The type of the pixels passed to glTexImage2D for the sized format, such as GL_UNSIGNED_BYTE.
+ * */
+struct rg_framebuffer*
+rg_framebuffer_new_with_format(int w, int h, GLenum internal_format, GLenum format, GLenum type);
+
 void
 rg_framebuffer_delete(struct rg_framebuffer* self);
 
@@ -0,0 +1,90 @@
+#include "memory.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <string.h>
+
+/**
+ * @brief The size of a huge page on the common platforms, in bytes.
+ * */
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+/**
+ * @brief The granularity at which buffers are touched, which is the size of a regular page.
+ * */
+#define TOUCH_SIZE ((size_t)4096)
+
+void*
+rg_aligned_malloc(const size_t alignment, const size_t size)
+{
+#ifdef _WIN32
+  return _aligned_malloc(size, alignment);
+#else
+  void* ptr = NULL;
+  if (posix_memalign(&ptr, alignment, size) != 0) {
+    return NULL;
+  }
+  return ptr;
+#endif
+}
+
+void
+rg_aligned_free(void* ptr)
+{
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+void*
+rg_buffer_alloc(size_t size, const int huge_pages)
+{
+  const size_t alignment = huge_pages ? HUGE_PAGE_SIZE : 64;
+
+  /* Rounding up to whole huge pages keeps the allocator from handing the tail of the last one to something else. */
+  size = ((size + alignment - 1) / alignment) * alignment;
+
+  if (size == 0) {
+    size = alignment;
+  }
+
+  unsigned char* ptr = rg_aligned_malloc(alignment, size);
+  if (!ptr) {
+    return NULL;
+  }
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (huge_pages) {
+    /* This is only advice, so a kernel without transparent huge pages simply keeps using regular pages. */
+    madvise(ptr, size, MADV_HUGEPAGE);
+  }
+#endif
+
+  const long num_chunks = (long)((size + TOUCH_SIZE - 1) / TOUCH_SIZE);
+
+#pragma omp parallel for schedule(static)
+  for (long i = 0; i < num_chunks; i++) {
+
+    const size_t offset = (size_t)i * TOUCH_SIZE;
+
+    memset(ptr + offset, 0, ((size - offset) < TOUCH_SIZE) ? (size - offset) : TOUCH_SIZE);
+  }
+
+  return ptr;
+}
+
+void
+rg_buffer_free(void* ptr)
+{
+  rg_aligned_free(ptr);
+}
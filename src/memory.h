@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief Allocates memory with a given alignment.
+ *
+ * @param alignment The alignment of the memory block, in bytes. Must be a power of two.
+ *
+ * @param size The size of the memory block, in bytes.
+ *
+ * @return On success, a pointer to the memory block. On failure, a null pointer.
+ * */
+void*
+rg_aligned_malloc(size_t alignment, size_t size);
+
+/**
+ * @brief Releases memory allocated with @ref rg_aligned_malloc.
+ * */
+void
+rg_aligned_free(void* ptr);
+
+/**
+ * @brief Allocates a large buffer of per-pixel data, such as a color buffer. The buffer is aligned to a cache line and
+ *        filled with zeros.
+ *
+ * @details The pages of the buffer are touched up front by a parallel loop, so that they are faulted in before the
+ *          first frame and in parallel. This does not place the pages near the render threads that use them: the
+ *          loop runs on the allocating thread's OpenMP team, and tiles are handed out by work stealing. Placement on
+ *          NUMA machines is done separately, by @ref rg_pipeline_set_numa.
+ *
+ * @param huge_pages If non-zero, the buffer is aligned to the size of a huge page and advised to be backed by
+ *                   transparent huge pages, on systems that support them. This saves TLB misses on large buffers.
+ *
+ * @return On success, a pointer to the buffer, to be released with @ref rg_buffer_free. On failure, a null pointer.
+ * */
+void*
+rg_buffer_alloc(size_t size, int huge_pages);
+
+void
+rg_buffer_free(void* ptr);
@@ -0,0 +1,366 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "numa.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief The largest number of nodes that are considered.
+ * */
+#define MAX_NODES 64
+
+/**
+ * @brief The memory policy that prefers a node, from the Linux kernel's mempolicy.h.
+ * */
+#define RG_MPOL_PREFERRED 1
+
+/**
+ * @brief The flag that moves pages that are already in memory to the node, from the Linux kernel's mempolicy.h.
+ * */
+#define RG_MPOL_MF_MOVE (1 << 1)
+
+struct rg_numa
+{
+  int num_nodes;
+
+  /**
+   * @brief The CPUs of all nodes, one node after another.
+   * */
+  int* cpus;
+
+  /**
+   * @brief The index of the first CPU of each node in @ref rg_numa::cpus, with one more entry for the end of the last
+   *        node.
+   * */
+  int cpu_offsets[MAX_NODES + 1];
+
+  /**
+   * @brief The number of each node, as the operating system knows it. Nodes without CPUs are skipped, so these are not
+   *        necessarily contiguous.
+   * */
+  int node_ids[MAX_NODES];
+
+  int num_threads;
+
+#ifdef __linux__
+  /**
+   * @brief The CPU affinity of each render thread from before it was pinned.
+   * */
+  cpu_set_t* saved_affinity;
+#endif
+
+  /**
+   * @brief Whether each render thread is pinned and has its affinity in @ref rg_numa::saved_affinity.
+   * */
+  unsigned char* pinned;
+};
+
+#ifdef __linux__
+
+/**
+ * @brief Parses a CPU list such as "0-3,8-11" and appends the CPUs to the topology.
+ *
+ * @return The number of CPUs that were appended, or -1 if memory could not be allocated.
+ * */
+static int
+parse_cpu_list(struct rg_numa* self, const char* list, int* num_cpus, int* capacity)
+{
+  int count = 0;
+
+  const char* p = list;
+
+  while (*p) {
+
+    char* end = NULL;
+
+    const long first = strtol(p, &end, 10);
+    if (end == p) {
+      break;
+    }
+
+    long last = first;
+
+    p = end;
+
+    if (*p == '-') {
+      p++;
+      last = strtol(p, &end, 10);
+      p = end;
+    }
+
+    for (long cpu = first; cpu <= last; cpu++) {
+
+      if (*num_cpus == *capacity) {
+
+        const int new_capacity = (*capacity > 0) ? (*capacity * 2) : 64;
+
+        int* cpus = realloc(self->cpus, sizeof(int) * (size_t)new_capacity);
+        if (!cpus) {
+          return -1;
+        }
+
+        self->cpus = cpus;
+        *capacity = new_capacity;
+      }
+
+      self->cpus[*num_cpus] = (int)cpu;
+      (*num_cpus)++;
+      count++;
+    }
+
+    if (*p == ',') {
+      p++;
+    } else {
+      break;
+    }
+  }
+
+  return count;
+}
+
+static void
+read_topology(struct rg_numa* self)
+{
+  int num_cpus = 0;
+  int capacity = 0;
+
+  for (int node = 0; (node < 1024) && (self->num_nodes < MAX_NODES); node++) {
+
+    char path[128];
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+      continue;
+    }
+
+    char list[4096];
+
+    const int ok = fgets(list, sizeof(list), file) != NULL;
+
+    fclose(file);
+
+    if (!ok) {
+      continue;
+    }
+
+    const int count = parse_cpu_list(self, list, &num_cpus, &capacity);
+    if (count < 0) {
+      break;
+    }
+
+    if (count == 0) {
+      /* Memory-only nodes have no threads to serve. */
+      continue;
+    }
+
+    self->node_ids[self->num_nodes] = node;
+    self->cpu_offsets[self->num_nodes + 1] = num_cpus;
+    self->num_nodes++;
+  }
+}
+
+#endif /* __linux__ */
+
+struct rg_numa*
+rg_numa_new(const int num_threads)
+{
+  struct rg_numa* self = malloc(sizeof(struct rg_numa));
+  if (!self) {
+    return NULL;
+  }
+
+  memset(self, 0, sizeof(struct rg_numa));
+
+  self->num_threads = (num_threads > 0) ? num_threads : 1;
+
+  self->pinned = calloc((size_t)self->num_threads, 1);
+
+#ifdef __linux__
+  self->saved_affinity = malloc(sizeof(cpu_set_t) * (size_t)self->num_threads);
+#endif
+
+  if (!self->pinned
+#ifdef __linux__
+      || !self->saved_affinity
+#endif
+  ) {
+    rg_numa_delete(self);
+    return NULL;
+  }
+
+#ifdef __linux__
+  read_topology(self);
+#endif
+
+  if (self->num_nodes == 0) {
+    free(self->cpus);
+    self->cpus = NULL;
+    self->num_nodes = 1;
+    self->cpu_offsets[0] = 0;
+    self->cpu_offsets[1] = 0;
+    self->node_ids[0] = 0;
+  }
+
+  return self;
+}
+
+void
+rg_numa_delete(struct rg_numa* self)
+{
+  if (self) {
+    free(self->cpus);
+    free(self->pinned);
+#ifdef __linux__
+    free(self->saved_affinity);
+#endif
+  }
+
+  free(self);
+}
+
+int
+rg_numa_num_nodes(const struct rg_numa* self)
+{
+  return self->num_nodes;
+}
+
+int
+rg_numa_thread_node(const struct rg_numa* self, const int thread, const int num_threads)
+{
+  if (num_threads <= 0) {
+    return 0;
+  }
+
+  const int node = (int)(((long long)thread * (long long)self->num_nodes) / (long long)num_threads);
+
+  return (node < self->num_nodes) ? node : (self->num_nodes - 1);
+}
+
+int
+rg_numa_pin_thread(struct rg_numa* self, const int thread, const int num_threads)
+{
+#ifdef __linux__
+  if ((thread < 0) || (thread >= self->num_threads)) {
+    return -1;
+  }
+
+  const int node = rg_numa_thread_node(self, thread, num_threads);
+
+  const int first_cpu = self->cpu_offsets[node];
+
+  const int node_cpus = self->cpu_offsets[node + 1] - first_cpu;
+
+  if (node_cpus <= 0) {
+    return -1;
+  }
+
+  /* The threads of a node are numbered from the first thread that maps to it. */
+
+  int first_thread = thread;
+
+  while ((first_thread > 0) && (rg_numa_thread_node(self, first_thread - 1, num_threads) == node)) {
+    first_thread--;
+  }
+
+  const int cpu = self->cpus[first_cpu + (thread - first_thread) % node_cpus];
+
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+
+  CPU_SET((size_t)cpu, &set);
+
+  if (!self->pinned[thread]) {
+
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &self->saved_affinity[thread]) != 0) {
+      return -1;
+    }
+  }
+
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) != 0) {
+    return -1;
+  }
+
+  self->pinned[thread] = 1;
+
+  return 0;
+#else
+  (void)self;
+  (void)thread;
+  (void)num_threads;
+  return -1;
+#endif
+}
+
+void
+rg_numa_unpin_thread(struct rg_numa* self, const int thread)
+{
+  if ((thread < 0) || (thread >= self->num_threads) || !self->pinned[thread]) {
+    return;
+  }
+
+#ifdef __linux__
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &self->saved_affinity[thread]);
+#endif
+
+  self->pinned[thread] = 0;
+}
+
+void
+rg_numa_bind(const struct rg_numa* self, void* ptr, const size_t size, const int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+  if ((self->num_nodes < 2) || (size == 0)) {
+    return;
+  }
+
+  const long page_size = sysconf(_SC_PAGESIZE);
+
+  const uintptr_t page_mask = (uintptr_t)((page_size > 0) ? page_size : 4096) - 1;
+
+  const uintptr_t begin = ((uintptr_t)ptr + page_mask) & ~page_mask;
+
+  const uintptr_t end = ((uintptr_t)ptr + size) & ~page_mask;
+
+  if (end <= begin) {
+    return;
+  }
+
+  const int node_id = self->node_ids[node];
+
+  unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+
+  memset(mask, 0, sizeof(mask));
+
+  mask[(size_t)node_id / (8 * sizeof(unsigned long))] = 1ul << ((size_t)node_id % (8 * sizeof(unsigned long)));
+
+  /* This is advice as well, so failures (such as from a kernel without NUMA support) are ignored. */
+
+  syscall(SYS_mbind,
+          (void*)begin,
+          (unsigned long)(end - begin),
+          RG_MPOL_PREFERRED,
+          mask,
+          (unsigned long)(sizeof(mask) * 8),
+          (unsigned)RG_MPOL_MF_MOVE);
+#else
+  (void)self;
+  (void)ptr;
+  (void)size;
+  (void)node;
+#endif
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief The NUMA topology of the machine: which CPUs belong to which memory node.
+ *
+ * @details The topology is read from sysfs on Linux. Elsewhere, or if it can't be read, the machine is treated as a
+ *          single node, and pinning threads and binding memory do nothing.
+ *
+ *          Render threads are split into one contiguous group per node, and the image is split into one band of rows
+ *          per node. The tiles and the memory of a band belong to the same node as the threads that render them.
+ * */
+struct rg_numa;
+
+/**
+ * @param num_threads The number of render threads, for keeping the CPU affinity that each one had before it was pinned.
+ * */
+struct rg_numa*
+rg_numa_new(int num_threads);
+
+void
+rg_numa_delete(struct rg_numa* self);
+
+int
+rg_numa_num_nodes(const struct rg_numa* self);
+
+/**
+ * @brief Gets the node that a render thread belongs to.
+ * */
+int
+rg_numa_thread_node(const struct rg_numa* self, int thread, int num_threads);
+
+/**
+ * @brief Pins the calling thread to one of the CPUs of its node, so that the thread stays close to the memory of its
+ *        band of the image. The thread's previous CPU affinity is kept, to be restored with @ref rg_numa_unpin_thread.
+ *
+ * @return Zero on success, or -1 if the thread could not be pinned.
+ * */
+int
+rg_numa_pin_thread(struct rg_numa* self, int thread, int num_threads);
+
+/**
+ * @brief Gives the calling thread back the CPU affinity that it had before @ref rg_numa_pin_thread was called with the
+ *        same thread index. Does nothing if that thread wasn't pinned.
+ * */
+void
+rg_numa_unpin_thread(struct rg_numa* self, int thread);
+
+/**
+ * @brief Moves the pages of a memory range to a node. Pages that are only partially inside of the range are left alone.
+ * */
+void
+rg_numa_bind(const struct rg_numa* self, void* ptr, size_t size, int node);
+
+/**
+ * @brief Gets the node that a row of the image belongs to.
+ * */
+static inline int
+rg_numa_row_node(const int y, const int height, const int num_nodes)
+{
+  return (int)(((long long)y * (long long)num_nodes) / (long long)height);
+}
+
+/**
+ * @brief Gets the first row of the band of a node. The band ends where the band of the next node starts.
+ * */
+static inline int
+rg_numa_band_start(const int node, const int height, const int num_nodes)
+{
+  return (int)(((long long)node * (long long)height + (long long)num_nodes - 1) / (long long)num_nodes);
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <embree3/rtcore.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The widest ray packet that the runtime will build.
+ * */
+#define RG_MAX_PACKET_SIZE 16
+
+/**
+ * @brief Storage for a ray packet of any of the widths supported by Embree.
+ *
+ * @note The packet types all share the same structure-of-arrays layout, where each field of the ray and hit is an array
+ *       of N elements. This is what makes it possible to fill any of them through a @p RTCRayHitN pointer with the
+ *       functions in this header, given N.
+ * */
+union rg_packet
+{
+  struct RTCRayHit4 p4;
+
+  struct RTCRayHit8 p8;
+
+  struct RTCRayHit16 p16;
+};
+
+/**
+ * @brief The index of each field in the structure-of-arrays packet layout.
+ * */
+enum rg_packet_field
+{
+  RG_PACKET_ORG_X,
+  RG_PACKET_ORG_Y,
+  RG_PACKET_ORG_Z,
+  RG_PACKET_TNEAR,
+  RG_PACKET_DIR_X,
+  RG_PACKET_DIR_Y,
+  RG_PACKET_DIR_Z,
+  RG_PACKET_TIME,
+  RG_PACKET_TFAR,
+  RG_PACKET_MASK,
+  RG_PACKET_ID,
+  RG_PACKET_FLAGS,
+  RG_PACKET_NG_X,
+  RG_PACKET_NG_Y,
+  RG_PACKET_NG_Z,
+  RG_PACKET_U,
+  RG_PACKET_V,
+  RG_PACKET_PRIM_ID,
+  RG_PACKET_GEOM_ID,
+  RG_PACKET_INST_ID
+};
+
+/**
+ * @brief Describes how the pixels of a packet are arranged on the screen.
+ *
+ * @param n The number of rays in the packet (4, 8 or 16).
+ *
+ * @param w Assigned the number of columns covered by the packet.
+ *
+ * @param h Assigned the number of rows covered by the packet.
+ * */
+static inline void
+rg_packet_shape(const uint32_t n, int* w, int* h)
+{
+  switch (n) {
+    case 4:
+      *w = 2;
+      *h = 2;
+      break;
+    case 8:
+      *w = 4;
+      *h = 2;
+      break;
+    case 16:
+      *w = 4;
+      *h = 4;
+      break;
+    default:
+      *w = 1;
+      *h = 1;
+      break;
+  }
+}
+
+/**
+ * @brief Gets the size of a single packet, in bytes.
+ * */
+static inline size_t
+rg_packet_bytes(const uint32_t n)
+{
+  switch (n) {
+    case 4:
+      return sizeof(struct RTCRayHit4);
+    case 8:
+      return sizeof(struct RTCRayHit8);
+    case 16:
+      return sizeof(struct RTCRayHit16);
+  }
+  return sizeof(struct RTCRayHit);
+}
+
+/**
+ * @brief Gets a packet from an array of packets.
+ * */
+static inline struct RTCRayHitN*
+rg_packet_at(struct RTCRayHitN* packets, const uint32_t n, const uint32_t index)
+{
+  return (struct RTCRayHitN*)(((char*)packets) + rg_packet_bytes(n) * index);
+}
+
+static inline float*
+rg_packet_float(struct RTCRayHitN* packet, const uint32_t n, const enum rg_packet_field field)
+{
+  return ((float*)packet) + n * (uint32_t)field;
+}
+
+static inline uint32_t*
+rg_packet_uint(struct RTCRayHitN* packet, const uint32_t n, const enum rg_packet_field field)
+{
+  return ((uint32_t*)packet) + n * (uint32_t)field;
+}
+
+/**
+ * @brief Copies a single ray into one lane of a packet and clears the hit of that lane.
+ * */
+static inline void
+rg_packet_set_ray(struct RTCRayHitN* packet, const uint32_t n, const uint32_t lane, const struct RTCRay* ray)
+{
+  rg_packet_float(packet, n, RG_PACKET_ORG_X)[lane] = ray->org_x;
+  rg_packet_float(packet, n, RG_PACKET_ORG_Y)[lane] = ray->org_y;
+  rg_packet_float(packet, n, RG_PACKET_ORG_Z)[lane] = ray->org_z;
+  rg_packet_float(packet, n, RG_PACKET_TNEAR)[lane] = ray->tnear;
+  rg_packet_float(packet, n, RG_PACKET_DIR_X)[lane] = ray->dir_x;
+  rg_packet_float(packet, n, RG_PACKET_DIR_Y)[lane] = ray->dir_y;
+  rg_packet_float(packet, n, RG_PACKET_DIR_Z)[lane] = ray->dir_z;
+  rg_packet_float(packet, n, RG_PACKET_TIME)[lane] = ray->time;
+  rg_packet_float(packet, n, RG_PACKET_TFAR)[lane] = ray->tfar;
+  rg_packet_uint(packet, n, RG_PACKET_MASK)[lane] = ray->mask;
+  rg_packet_uint(packet, n, RG_PACKET_ID)[lane] = ray->id;
+  rg_packet_uint(packet, n, RG_PACKET_FLAGS)[lane] = ray->flags;
+  rg_packet_uint(packet, n, RG_PACKET_GEOM_ID)[lane] = RTC_INVALID_GEOMETRY_ID;
+  rg_packet_uint(packet, n, RG_PACKET_INST_ID)[lane] = RTC_INVALID_GEOMETRY_ID;
+}
+
+/**
+ * @brief Intersects a packet with the scene, using the packet function that matches the packet width.
+ * */
+static inline void
+rg_packet_intersect(struct RTCRayHitN* packet,
+                    const uint32_t n,
+                    const int* valid,
+                    RTCScene scene,
+                    struct RTCIntersectContext* context)
+{
+  switch (n) {
+    case 4:
+      rtcIntersect4(valid, scene, context, (struct RTCRayHit4*)packet);
+      break;
+    case 8:
+      rtcIntersect8(valid, scene, context, (struct RTCRayHit8*)packet);
+      break;
+    case 16:
+      rtcIntersect16(valid, scene, context, (struct RTCRayHit16*)packet);
+      break;
+  }
+}
@@ -1,32 +1,246 @@
 #include "pipeline.h"
 
+#include "convert.h"
+#include "memory.h"
+#include "numa.h"
+
+#ifdef RAYGUN_GL
 #include "framebuffer.h"
-#include "random.h"
 
 #include <glad/glad.h>
+#endif
 
+#include <pthread.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+/**
+ * @brief The number of frames a pixel must have been sampled in before it can be considered converged. Fewer frames
+ *        don't give a reliable variance estimate.
+ * */
+#define MIN_ADAPTIVE_FRAMES 4
+
+/**
+ * @brief The luminance below which the error of a pixel is measured in absolute rather than relative terms, so that
+ *        dark pixels can converge.
+ * */
+#define MIN_ADAPTIVE_LUMINANCE 0.01f
+
+/**
+ * @brief The number of pixel unpack buffers that frames are uploaded through. While the GPU copies one frame out of a
+ *        buffer, the next frames are written into the others.
+ * */
+#define UPLOAD_RING_SIZE 3
+
+/**
+ * @brief The time to wait at once for the GPU to finish with an upload buffer, in nanoseconds. The wait is repeated
+ *        until the buffer is free, since writing to it any earlier would corrupt the upload still reading from it.
+ * */
+#define UPLOAD_WAIT_TIMEOUT 1000000000ull
+
+/**
+ * @brief The granularity of the allocated size of the pipeline, in pixels along each axis.
+ * */
+#define RESIZE_BUCKET 256
+
+/**
+ * @brief Running statistics of the luminance of each pixel.
+ *
+ * @details Each frame contributes the average of its samples as one observation, weighted by the number of samples,
+ *          and the statistics are updated incrementally with West's weighted variant of Welford's algorithm.
+ * */
+struct pixel_stats
+{
+  /**
+   * @brief The number of samples of each pixel.
+   * */
+  float* weight;
+
+  /**
+   * @brief The number of frames that contributed to each pixel.
+   * */
+  uint32_t* frames;
+
+  float* mean;
+
+  /**
+   * @brief The weighted sum of squared differences from the mean.
+   * */
+  float* m2;
+
+  unsigned char* active;
+
+  float threshold;
+};
+
+/**
+ * @brief One of the three color buffers, along with the size of the image it holds.
+ * */
+struct color_buffer
+{
+  float* data;
+
+  /**
+   * @brief The frame, resolved for display. Only allocated if frames are resolved on the CPU.
+   * */
+  unsigned char* rgba8;
+
+  int width;
+
+  int height;
+};
 
 struct rg_pipeline
 {
+  /**
+   * @brief The width of the render resolution, which may be less than the size the pipeline was created with.
+   * */
   int width;
 
   int height;
 
-  float* color_buffer;
+  /**
+   * @brief The output size, which is the largest render resolution.
+   * */
+  int max_width;
+
+  int max_height;
+
+  /**
+   * @brief The size that the buffers and textures were allocated for. This is the largest output size so far, rounded
+   *        up to whole buckets, so that resizing the window only reallocates once the output outgrows it.
+   * */
+  int capacity_width;
+
+  int capacity_height;
+
+  /**
+   * @brief Whether the per-pixel buffers are backed by huge pages.
+   * */
+  int huge_pages;
+
+  /**
+   * @brief The NUMA topology that the per-pixel memory is placed by, or a null pointer.
+   * */
+  const struct rg_numa* numa;
+
+  /**
+   * @brief The color buffers. At any time, one is being written by the render thread, one holds the latest complete
+   *        frame, and one is being uploaded by the present thread. The roles are only exchanged while holding @ref
+   *        rg_pipeline::lock.
+   * */
+  struct color_buffer buffers[3];
 
-  struct rg_random* random_buffer;
+  int write_index;
 
+  int ready_index;
+
+  int present_index;
+
+  /**
+   * @brief Whether the ready buffer holds a frame that hasn't been presented yet.
+   * */
+  int ready_is_new;
+
+  pthread_mutex_t lock;
+
+  pthread_cond_t ready_cond;
+
+  int num_textures;
+
+  int interleaved;
+
+  /**
+   * @brief Whether frames are uploaded in half precision.
+   * */
+  int half_float;
+
+  /**
+   * @brief The size of one pixel of an uploaded frame, in bytes.
+   * */
+  size_t upload_pixel_size;
+
+  /**
+   * @brief Holds a converted frame, for when it can't be written to an upload buffer. Only allocated if frames are
+   *        interleaved or converted to half precision on upload.
+   * */
+  void* staging;
+
+  /**
+   * @brief Whether frames are accumulated, tone mapped and quantized on the CPU, and uploaded as 8-bit sRGB.
+   * */
+  int cpu_resolve;
+
+  float exposure;
+
+  /**
+   * @brief The sum of the frames since the accumulation was last reset, weighted by their sample counts, as three
+   *        planes. Only allocated if frames are resolved on the CPU.
+   * */
+  float* accum;
+
+  /**
+   * @brief The sum of the weights of the frames in @ref rg_pipeline::accum, or zero if it is empty.
+   * */
+  float accum_weight;
+
+  int accum_width;
+
+  int accum_height;
+
+  unsigned char srgb_lut[RG_SRGB_LUT_SIZE];
+
+  /**
+   * @brief The number of frames that were published.
+   * */
+  uint32_t frame_index;
+
+  /**
+   * @brief The number of frames that were presented. Picks the accumulation framebuffer that is read.
+   * */
+  uint32_t present_count;
+
+  int sync_initialized;
+
+  /**
+   * @brief Only allocated while adaptive sampling is enabled.
+   * */
+  struct pixel_stats* stats;
+
+#ifdef RAYGUN_GL
+  /**
+   * @brief The color textures. With the interleaved layout, only the first one is used.
+   * */
   GLuint textures[3];
 
   int textures_allocated;
 
+  /**
+   * @brief The pixel unpack buffers that frames are uploaded through.
+   * */
+  GLuint upload_buffers[UPLOAD_RING_SIZE];
+
+  /**
+   * @brief The fence after the last upload from each buffer, or a null pointer if there is none pending.
+   * */
+  GLsync upload_fences[UPLOAD_RING_SIZE];
+
+  int upload_buffers_allocated;
+
+  /**
+   * @brief The index of the upload buffer that the next frame is written into.
+   * */
+  int upload_next;
+
   struct rg_framebuffer* accumulate_fb[2];
 
   struct rg_framebuffer* tone_fb;
-
-  uint32_t frame_index;
+#endif
 };
 
 #if 0
@@ -38,50 +252,122 @@ rg_get_write_framebuffer(struct rg_pipeline* self, struct rg_framebuffer** frame
 }
 #endif
 
+#ifdef RAYGUN_GL
 static struct rg_framebuffer*
 rg_get_read_framebuffer(struct rg_pipeline* self, struct rg_framebuffer** framebuffers)
 {
-  const int index = (self->frame_index + 1) % 2;
+  const int index = (self->present_count + 1) % 2;
   return framebuffers[index];
 }
+#endif
 
-struct rg_pipeline*
-rg_pipeline_new(int w, int h)
+static void
+free_pixel_stats(struct pixel_stats* stats)
 {
-  struct rg_pipeline* self = malloc(sizeof(struct rg_pipeline));
-  if (!self) {
-    return NULL;
+  if (stats) {
+    rg_buffer_free(stats->weight);
+    rg_buffer_free(stats->frames);
+    rg_buffer_free(stats->mean);
+    rg_buffer_free(stats->m2);
+    rg_buffer_free(stats->active);
   }
 
-  memset(self, 0, sizeof(struct rg_pipeline));
+  free(stats);
+}
 
-  self->width = w;
+/**
+ * @brief Rounds a size up to a whole number of buckets.
+ * */
+static int
+round_to_bucket(const int size)
+{
+  return ((size + RESIZE_BUCKET - 1) / RESIZE_BUCKET) * RESIZE_BUCKET;
+}
 
-  self->height = h;
+/**
+ * @brief Allocates the per-pixel memory for the capacity of the pipeline.
+ * */
+static int
+alloc_buffers(struct rg_pipeline* self)
+{
+  const size_t n = (size_t)self->capacity_width * (size_t)self->capacity_height;
 
-  self->color_buffer = malloc(sizeof(float) * (size_t)w * (size_t)h * 3u);
+  for (int i = 0; i < 3; i++) {
 
-  if (!self->color_buffer) {
-    free(self);
-    return NULL;
+    self->buffers[i].data = rg_buffer_alloc(sizeof(float) * n * 3u, self->huge_pages);
+
+    if (!self->buffers[i].data) {
+      return -1;
+    }
   }
 
-  self->random_buffer = malloc(sizeof(struct rg_random) * (size_t)w * (size_t)h);
-  if (!self->random_buffer) {
-    free(self->color_buffer);
-    free(self);
-    return NULL;
+  if (self->cpu_resolve) {
+
+    self->accum = rg_buffer_alloc(sizeof(float) * n * 3u, self->huge_pages);
+
+    if (!self->accum) {
+      return -1;
+    }
+
+    for (int i = 0; i < 3; i++) {
+
+      self->buffers[i].rgba8 = rg_buffer_alloc(n * 4u, self->huge_pages);
+
+      if (!self->buffers[i].rgba8) {
+        return -1;
+      }
+    }
+
+  } else if (self->interleaved || self->half_float) {
+
+    self->staging = rg_buffer_alloc(self->upload_pixel_size * n, self->huge_pages);
+
+    if (!self->staging) {
+      return -1;
+    }
   }
 
-  for (int i = 0; i < (w * h); i++) {
-    self->random_buffer[i].state = (uint32_t)i;
+  return 0;
+}
+
+static void
+free_buffers(struct rg_pipeline* self)
+{
+  for (int i = 0; i < 3; i++) {
+    rg_buffer_free(self->buffers[i].data);
+    rg_buffer_free(self->buffers[i].rgba8);
+    self->buffers[i].data = NULL;
+    self->buffers[i].rgba8 = NULL;
   }
 
-  glGenTextures(3, self->textures);
+  rg_buffer_free(self->accum);
+
+  rg_buffer_free(self->staging);
+
+  self->accum = NULL;
+
+  self->staging = NULL;
+}
+
+#ifdef RAYGUN_GL
+/**
+ * @brief Creates the textures, upload buffers and framebuffers for the capacity of the pipeline.
+ * */
+static int
+alloc_gl_objects(struct rg_pipeline* self)
+{
+  const int w = self->capacity_width;
+  const int h = self->capacity_height;
+
+  /* The rows of a frame are packed. With the default alignment of four bytes, a planar half float frame of odd width
+   * would be read with padded rows. */
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  glGenTextures(self->num_textures, self->textures);
 
   self->textures_allocated = 1;
 
-  for (int i = 0; i < 3; i++) {
+  for (int i = 0; i < self->num_textures; i++) {
 
     glBindTexture(GL_TEXTURE_2D, self->textures[i]);
 
@@ -91,23 +377,154 @@ rg_pipeline_new(int w, int h)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, w, h, 0, GL_ALPHA, GL_FLOAT, NULL);
+    if (self->cpu_resolve) {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    } else if (self->interleaved && self->half_float) {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, w, h, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    } else if (self->interleaved) {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, w, h, 0, GL_RGBA, GL_FLOAT, NULL);
+    } else if (self->half_float) {
+      /* Unsized alpha textures only take half floats through an extension, so a sized red texture stands in for one.
+       * The shader reads the alpha channel of the planar textures. */
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, w, h, 0, GL_RED, GL_HALF_FLOAT, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_RED);
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, w, h, 0, GL_ALPHA, GL_FLOAT, NULL);
+    }
+  }
+
+  glGenBuffers(UPLOAD_RING_SIZE, self->upload_buffers);
+
+  self->upload_buffers_allocated = 1;
+
+  const size_t upload_size = self->upload_pixel_size * (size_t)w * (size_t)h;
+
+  for (int i = 0; i < UPLOAD_RING_SIZE; i++) {
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, self->upload_buffers[i]);
+
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)upload_size, NULL, GL_STREAM_DRAW);
   }
 
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
   self->accumulate_fb[0] = rg_framebuffer_new(w, h);
   if (!self->accumulate_fb[0]) {
-    rg_pipeline_delete(self);
-    return NULL;
+    return -1;
   }
 
   self->accumulate_fb[1] = rg_framebuffer_new(w, h);
   if (!self->accumulate_fb[1]) {
-    rg_pipeline_delete(self);
-    return NULL;
+    return -1;
   }
 
   self->tone_fb = rg_framebuffer_new(w, h);
   if (!self->tone_fb) {
+    return -1;
+  }
+
+  return 0;
+}
+
+static void
+free_gl_objects(struct rg_pipeline* self)
+{
+  if (self->textures_allocated) {
+    glDeleteTextures(self->num_textures, self->textures);
+    self->textures_allocated = 0;
+  }
+
+  for (int i = 0; i < UPLOAD_RING_SIZE; i++) {
+    if (self->upload_fences[i]) {
+      glDeleteSync(self->upload_fences[i]);
+      self->upload_fences[i] = NULL;
+    }
+  }
+
+  if (self->upload_buffers_allocated) {
+    glDeleteBuffers(UPLOAD_RING_SIZE, self->upload_buffers);
+    self->upload_buffers_allocated = 0;
+  }
+
+  self->upload_next = 0;
+
+  rg_framebuffer_delete(self->accumulate_fb[0]);
+  rg_framebuffer_delete(self->accumulate_fb[1]);
+
+  rg_framebuffer_delete(self->tone_fb);
+
+  self->accumulate_fb[0] = NULL;
+  self->accumulate_fb[1] = NULL;
+
+  self->tone_fb = NULL;
+}
+
+int
+rg_pipeline_setup_textures(struct rg_pipeline* self)
+{
+  return alloc_gl_objects(self);
+}
+#endif
+
+struct rg_pipeline*
+rg_pipeline_new(int w, int h, const struct raygun_config* config)
+{
+  struct rg_pipeline* self = malloc(sizeof(struct rg_pipeline));
+  if (!self) {
+    return NULL;
+  }
+
+  memset(self, 0, sizeof(struct rg_pipeline));
+
+  self->width = w;
+
+  self->height = h;
+
+  self->max_width = w;
+
+  self->max_height = h;
+
+  self->capacity_width = round_to_bucket(w);
+
+  self->capacity_height = round_to_bucket(h);
+
+  self->huge_pages = config->huge_pages != 0;
+
+  self->write_index = 0;
+  self->ready_index = 1;
+  self->present_index = 2;
+
+  for (int i = 0; i < 3; i++) {
+    self->buffers[i].width = w;
+    self->buffers[i].height = h;
+  }
+
+  pthread_mutex_init(&self->lock, NULL);
+
+  pthread_cond_init(&self->ready_cond, NULL);
+
+  self->sync_initialized = 1;
+
+  self->cpu_resolve = config->resolve_mode == RAYGUN_RESOLVE_CPU;
+
+  self->exposure = config->exposure;
+
+  self->interleaved = self->cpu_resolve || (config->color_layout == RAYGUN_COLOR_LAYOUT_INTERLEAVED);
+
+  self->half_float = !self->cpu_resolve && (config->half_float_upload != 0);
+
+  self->num_textures = self->interleaved ? 1 : 3;
+
+  self->upload_pixel_size = (self->half_float ? sizeof(uint16_t) : sizeof(float)) * (self->interleaved ? 4u : 3u);
+
+  if (self->cpu_resolve) {
+
+    self->upload_pixel_size = 4;
+
+    rg_srgb_lut_init(self->srgb_lut);
+  }
+
+  if (alloc_buffers(self) != 0) {
     rg_pipeline_delete(self);
     return NULL;
   }
@@ -120,33 +537,27 @@ rg_pipeline_delete(struct rg_pipeline* self)
 {
   if (self) {
 
-    free(self->color_buffer);
+    free_pixel_stats(self->stats);
 
-    free(self->random_buffer);
+    free_buffers(self);
 
-    if (self->textures_allocated) {
-      glDeleteTextures(3, self->textures);
+    if (self->sync_initialized) {
+      pthread_mutex_destroy(&self->lock);
+      pthread_cond_destroy(&self->ready_cond);
     }
 
-    rg_framebuffer_delete(self->accumulate_fb[0]);
-    rg_framebuffer_delete(self->accumulate_fb[1]);
-
-    rg_framebuffer_delete(self->tone_fb);
+#ifdef RAYGUN_GL
+    free_gl_objects(self);
+#endif
   }
 
   free(self);
 }
 
-struct rg_random*
-rg_pipeline_random_buffer(struct rg_pipeline* self)
-{
-  return self->random_buffer;
-}
-
 float*
 rg_pipeline_color_buffer(struct rg_pipeline* self)
 {
-  return self->color_buffer;
+  return self->buffers[self->write_index].data;
 }
 
 void
@@ -156,27 +567,751 @@ rg_pipeline_size(struct rg_pipeline* self, int* w, int* h)
   *h = self->height;
 }
 
+/**
+ * @brief Moves each band of rows of a per-pixel buffer to the NUMA node that the band belongs to.
+ *
+ * @param value_size The size of the value of one pixel, in bytes.
+ *
+ * @param num_planes The number of planes of the buffer, each the size of the image.
+ * */
+static void
+bind_buffer(const struct rg_pipeline* self, void* ptr, const size_t value_size, const int num_planes)
+{
+  if (!self->numa || !ptr) {
+    return;
+  }
+
+  const int num_nodes = rg_numa_num_nodes(self->numa);
+
+  const size_t w = (size_t)self->width;
+  const size_t n = w * (size_t)self->height;
+
+  for (int plane = 0; plane < num_planes; plane++) {
+
+    unsigned char* base = (unsigned char*)ptr + n * value_size * (size_t)plane;
+
+    for (int node = 0; node < num_nodes; node++) {
+
+      const size_t y0 = (size_t)rg_numa_band_start(node, self->height, num_nodes);
+      const size_t y1 = (size_t)rg_numa_band_start(node + 1, self->height, num_nodes);
+
+      rg_numa_bind(self->numa, base + y0 * w * value_size, (y1 - y0) * w * value_size, node);
+    }
+  }
+}
+
+static void
+bind_pixel_stats(const struct rg_pipeline* self)
+{
+  const struct pixel_stats* stats = self->stats;
+  if (!stats) {
+    return;
+  }
+
+  bind_buffer(self, stats->weight, sizeof(float), 1);
+  bind_buffer(self, stats->frames, sizeof(uint32_t), 1);
+  bind_buffer(self, stats->mean, sizeof(float), 1);
+  bind_buffer(self, stats->m2, sizeof(float), 1);
+  bind_buffer(self, stats->active, 1, 1);
+}
+
 void
-rg_pipeline_sync_textures(struct rg_pipeline* self)
+rg_pipeline_set_numa(struct rg_pipeline* self, const struct rg_numa* numa)
+{
+  self->numa = numa;
+
+  for (int i = 0; i < 3; i++) {
+    bind_buffer(self, self->buffers[i].data, sizeof(float), 3);
+    bind_buffer(self, self->buffers[i].rgba8, 4, 1);
+  }
+
+  bind_buffer(self, self->accum, sizeof(float), 3);
+
+  bind_pixel_stats(self);
+}
+
+int
+rg_pipeline_enable_adaptive(struct rg_pipeline* self, const float threshold)
+{
+  if (self->stats) {
+    self->stats->threshold = threshold;
+    return 0;
+  }
+
+  const size_t n = (size_t)self->capacity_width * (size_t)self->capacity_height;
+
+  struct pixel_stats* stats = calloc(1, sizeof(struct pixel_stats));
+  if (!stats) {
+    return -1;
+  }
+
+  stats->weight = rg_buffer_alloc(sizeof(float) * n, self->huge_pages);
+  stats->frames = rg_buffer_alloc(sizeof(uint32_t) * n, self->huge_pages);
+  stats->mean = rg_buffer_alloc(sizeof(float) * n, self->huge_pages);
+  stats->m2 = rg_buffer_alloc(sizeof(float) * n, self->huge_pages);
+  stats->active = rg_buffer_alloc(n, self->huge_pages);
+
+  if (!stats->weight || !stats->frames || !stats->mean || !stats->m2 || !stats->active) {
+    free_pixel_stats(stats);
+    return -1;
+  }
+
+  stats->threshold = threshold;
+
+  self->stats = stats;
+
+  bind_pixel_stats(self);
+
+  rg_pipeline_reset_adaptive(self);
+
+  return 0;
+}
+
+void
+rg_pipeline_reset_adaptive(struct rg_pipeline* self)
+{
+  struct pixel_stats* stats = self->stats;
+  if (!stats) {
+    return;
+  }
+
+  const size_t n = (size_t)self->width * (size_t)self->height;
+
+  memset(stats->weight, 0, sizeof(float) * n);
+  memset(stats->frames, 0, sizeof(uint32_t) * n);
+  memset(stats->mean, 0, sizeof(float) * n);
+  memset(stats->m2, 0, sizeof(float) * n);
+  memset(stats->active, 1, n);
+}
+
+int
+rg_pipeline_add_sample(struct rg_pipeline* self,
+                       const int pixel,
+                       const float r,
+                       const float g,
+                       const float b,
+                       const float weight)
+{
+  struct pixel_stats* stats = self->stats;
+
+  const size_t stride = (size_t)self->width * (size_t)self->height;
+
+  float* color_r = self->buffers[self->write_index].data + pixel;
+  float* color_g = color_r + stride;
+  float* color_b = color_g + stride;
+
+  const float total = stats->weight[pixel] + weight;
+
+  const float k = weight / total;
+
+  *color_r += (r - *color_r) * k;
+  *color_g += (g - *color_g) * k;
+  *color_b += (b - *color_b) * k;
+
+  const float luminance = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+
+  const float delta = luminance - stats->mean[pixel];
+
+  stats->mean[pixel] += delta * k;
+
+  stats->m2[pixel] += weight * delta * (luminance - stats->mean[pixel]);
+
+  stats->weight[pixel] = total;
+
+  const uint32_t frames = ++stats->frames[pixel];
+
+  int active = 1;
+
+  if (frames >= MIN_ADAPTIVE_FRAMES) {
+
+    /* Each observation is the average of (weight) samples, so m2 / (frames - 1) estimates the variance of a single
+     * sample, and dividing that by the number of samples gives the variance of the mean. */
+
+    const float variance = stats->m2[pixel] / ((float)(frames - 1) * total);
+
+    const float error = sqrtf(variance > 0.0f ? variance : 0.0f);
+
+    const float mean = stats->mean[pixel];
+
+    active = error > (stats->threshold * ((mean > MIN_ADAPTIVE_LUMINANCE) ? mean : MIN_ADAPTIVE_LUMINANCE));
+  }
+
+  stats->active[pixel] = (unsigned char)active;
+
+  return active;
+}
+
+const unsigned char*
+rg_pipeline_active_mask(const struct rg_pipeline* self)
+{
+  return self->stats ? self->stats->active : NULL;
+}
+
+/**
+ * @brief Interpolates bilinearly between the pixels of a plane, at a position in pixel units.
+ * */
+static float
+sample_bilinear(const float* plane, const int w, const int h, float x, float y)
+{
+  x = (x < 0.0f) ? 0.0f : ((x > (float)(w - 1)) ? (float)(w - 1) : x);
+  y = (y < 0.0f) ? 0.0f : ((y > (float)(h - 1)) ? (float)(h - 1) : y);
+
+  const int x0 = (int)x;
+  const int y0 = (int)y;
+  const int x1 = (x0 + 1 < w) ? (x0 + 1) : x0;
+  const int y1 = (y0 + 1 < h) ? (y0 + 1) : y0;
+
+  const float fx = x - (float)x0;
+  const float fy = y - (float)y0;
+
+  const float top = plane[y0 * w + x0] * (1.0f - fx) + plane[y0 * w + x1] * fx;
+  const float bottom = plane[y1 * w + x0] * (1.0f - fx) + plane[y1 * w + x1] * fx;
+
+  return top * (1.0f - fy) + bottom * fy;
+}
+
+/**
+ * @brief Carries the accumulated pixels over to a new render resolution. The mean colors are resampled bilinearly and
+ *        the statistics are taken from the nearest old pixel. When the resolution goes up, each new pixel is backed by
+ *        fewer samples than the old one was, so the sample counts are scaled down to match. Every pixel becomes active
+ *        again, since the error estimates no longer match the resampled means exactly.
+ * */
+static int
+resample_history(struct rg_pipeline* self, const int old_w, const int old_h)
+{
+  struct pixel_stats* stats = self->stats;
+
+  const int new_w = self->width;
+  const int new_h = self->height;
+
+  const size_t old_n = (size_t)old_w * (size_t)old_h;
+  const size_t new_n = (size_t)new_w * (size_t)new_h;
+
+  float* old_color = malloc(sizeof(float) * old_n * 3);
+  float* old_weight = malloc(sizeof(float) * old_n);
+  uint32_t* old_frames = malloc(sizeof(uint32_t) * old_n);
+  float* old_mean = malloc(sizeof(float) * old_n);
+  float* old_m2 = malloc(sizeof(float) * old_n);
+
+  if (!old_color || !old_weight || !old_frames || !old_mean || !old_m2) {
+    free(old_color);
+    free(old_weight);
+    free(old_frames);
+    free(old_mean);
+    free(old_m2);
+    return -1;
+  }
+
+  float* color_buffer = self->buffers[self->write_index].data;
+
+  memcpy(old_color, color_buffer, sizeof(float) * old_n * 3);
+  memcpy(old_weight, stats->weight, sizeof(float) * old_n);
+  memcpy(old_frames, stats->frames, sizeof(uint32_t) * old_n);
+  memcpy(old_mean, stats->mean, sizeof(float) * old_n);
+  memcpy(old_m2, stats->m2, sizeof(float) * old_n);
+
+  const float scale_x = ((float)old_w) / ((float)new_w);
+  const float scale_y = ((float)old_h) / ((float)new_h);
+
+  const float area_ratio = (scale_x * scale_y < 1.0f) ? (scale_x * scale_y) : 1.0f;
+
+  for (int y = 0; y < new_h; y++) {
+
+    const float sy = (((float)y) + 0.5f) * scale_y - 0.5f;
+
+    const int ny_unclamped = (int)((((float)y) + 0.5f) * scale_y);
+    const int ny = (ny_unclamped < old_h) ? ny_unclamped : (old_h - 1);
+
+    for (int x = 0; x < new_w; x++) {
+
+      const float sx = (((float)x) + 0.5f) * scale_x - 0.5f;
+
+      const int nx_unclamped = (int)((((float)x) + 0.5f) * scale_x);
+      const int nx = (nx_unclamped < old_w) ? nx_unclamped : (old_w - 1);
+
+      const size_t src = (size_t)ny * (size_t)old_w + (size_t)nx;
+
+      const size_t dst = (size_t)y * (size_t)new_w + (size_t)x;
+
+      for (int c = 0; c < 3; c++) {
+        const float* old_plane = old_color + old_n * (size_t)c;
+        color_buffer[new_n * (size_t)c + dst] = sample_bilinear(old_plane, old_w, old_h, sx, sy);
+      }
+
+      stats->weight[dst] = old_weight[src] * area_ratio;
+      stats->frames[dst] = old_frames[src];
+      stats->mean[dst] = old_mean[src];
+      stats->m2[dst] = old_m2[src];
+    }
+  }
+
+  memset(stats->active, 1, new_n);
+
+  free(old_color);
+  free(old_weight);
+  free(old_frames);
+  free(old_mean);
+  free(old_m2);
+
+  return 0;
+}
+
+int
+rg_pipeline_set_render_size(struct rg_pipeline* self, int w, int h)
+{
+  w = (w < 1) ? 1 : ((w > self->max_width) ? self->max_width : w);
+  h = (h < 1) ? 1 : ((h > self->max_height) ? self->max_height : h);
+
+  if ((w == self->width) && (h == self->height)) {
+    return 0;
+  }
+
+  const int old_w = self->width;
+  const int old_h = self->height;
+
+  self->width = w;
+  self->height = h;
+
+  if (self->stats && (resample_history(self, old_w, old_h) != 0)) {
+    rg_pipeline_reset_adaptive(self);
+    return -1;
+  }
+
+  return 0;
+}
+
+void
+rg_pipeline_max_size(const struct rg_pipeline* self, int* w, int* h)
+{
+  *w = self->max_width;
+  *h = self->max_height;
+}
+
+int
+rg_pipeline_fits(const struct rg_pipeline* self, const int w, const int h)
+{
+  return (w <= self->capacity_width) && (h <= self->capacity_height);
+}
+
+int
+rg_pipeline_reserve(struct rg_pipeline* self, const int w, const int h)
+{
+  if (rg_pipeline_fits(self, w, h)) {
+    return 0;
+  }
+
+  /* Growing by at least a quarter at a time keeps a window drag from reallocating on every bucket it crosses. */
+
+  if (w > self->capacity_width) {
+    const int grown = self->capacity_width + self->capacity_width / 4;
+    self->capacity_width = round_to_bucket((w > grown) ? w : grown);
+  }
+
+  if (h > self->capacity_height) {
+    const int grown = self->capacity_height + self->capacity_height / 4;
+    self->capacity_height = round_to_bucket((h > grown) ? h : grown);
+  }
+
+#ifdef RAYGUN_GL
+  const int has_textures = self->textures_allocated;
+
+  free_gl_objects(self);
+#endif
+
+  free_buffers(self);
+
+  self->ready_is_new = 0;
+
+  self->accum_weight = 0.0f;
+
+  if (alloc_buffers(self) != 0) {
+    return -1;
+  }
+
+#ifdef RAYGUN_GL
+  if (has_textures && (alloc_gl_objects(self) != 0)) {
+    return -1;
+  }
+#endif
+
+  if (self->stats) {
+
+    const float threshold = self->stats->threshold;
+
+    free_pixel_stats(self->stats);
+
+    self->stats = NULL;
+
+    if (rg_pipeline_enable_adaptive(self, threshold) != 0) {
+      return -1;
+    }
+  }
+
+  if (self->numa) {
+    rg_pipeline_set_numa(self, self->numa);
+  }
+
+  return 0;
+}
+
+void
+rg_pipeline_set_output_size(struct rg_pipeline* self, int w, int h)
+{
+  w = (w < 1) ? 1 : ((w > self->capacity_width) ? self->capacity_width : w);
+  h = (h < 1) ? 1 : ((h > self->capacity_height) ? self->capacity_height : h);
+
+  const int render_w = (int)((double)self->width * (double)w / (double)self->max_width + 0.5);
+  const int render_h = (int)((double)self->height * (double)h / (double)self->max_height + 0.5);
+
+  self->max_width = w;
+  self->max_height = h;
+
+  self->width = (render_w < 1) ? 1 : ((render_w > w) ? w : render_w);
+  self->height = (render_h < 1) ? 1 : ((render_h > h) ? h : render_h);
+
+  rg_pipeline_reset_adaptive(self);
+
+  rg_pipeline_reset_accumulation(self);
+}
+
+void
+rg_pipeline_reset_accumulation(struct rg_pipeline* self)
 {
-  float* ptr = self->color_buffer;
+  self->accum_weight = 0.0f;
+}
+
+void
+rg_pipeline_resolve(struct rg_pipeline* self, const float weight, const int preview)
+{
+  if (!self->cpu_resolve) {
+    return;
+  }
+
+  const int w = self->width;
+  const int h = self->height;
+
+  const size_t n = (size_t)w * (size_t)h;
+
+  const float* color = self->buffers[self->write_index].data;
 
-  const int stride = self->width * self->height;
+  unsigned char* rgba8 = self->buffers[self->write_index].rgba8;
+
+  /* With adaptive sampling, the color buffer already holds the mean of all samples. Previews are shown as they are,
+   * and the accumulation starts over with the next full resolution frame. */
+
+  const int accumulate = !preview && !self->stats;
+
+  if (!accumulate || (w != self->accum_width) || (h != self->accum_height)) {
+    self->accum_weight = 0.0f;
+    self->accum_width = w;
+    self->accum_height = h;
+  }
+
+  const int first = self->accum_weight == 0.0f;
+
+  if (accumulate) {
+    self->accum_weight += weight;
+  }
+
+  const float* src = accumulate ? self->accum : color;
+
+  const float scale = accumulate ? (self->exposure / self->accum_weight) : self->exposure;
+
+#pragma omp parallel for schedule(static)
+  for (int y = 0; y < h; y++) {
+
+    const size_t offset = (size_t)y * (size_t)w;
+
+    if (accumulate) {
+
+      float* restrict sum = self->accum + offset;
+
+      const float* restrict frame = color + offset;
+
+      for (int c = 0; c < 3; c++) {
+
+        float* restrict sum_c = sum + n * (size_t)c;
+
+        const float* restrict frame_c = frame + n * (size_t)c;
+
+        if (first) {
+#pragma omp simd
+          for (int x = 0; x < w; x++) {
+            sum_c[x] = frame_c[x] * weight;
+          }
+        } else {
+#pragma omp simd
+          for (int x = 0; x < w; x++) {
+            sum_c[x] += frame_c[x] * weight;
+          }
+        }
+      }
+    }
+
+    rg_tonemap_rgba8(
+      src + offset, src + n + offset, src + n * 2 + offset, (size_t)w, scale, self->srgb_lut, rgba8 + offset * 4);
+  }
+}
+
+void
+rg_pipeline_average(struct rg_pipeline* self, float* rgb, const float weight, float* total_weight)
+{
+  const size_t n = (size_t)self->width * (size_t)self->height;
+
+  const float* color = self->buffers[self->write_index].data;
+
+  const float total = *total_weight + weight;
+
+  /* With adaptive sampling, the color buffer already holds the mean of all samples, so it replaces the average. */
+
+  const float k = (self->stats || (total <= 0.0f)) ? 1.0f : (weight / total);
+
+  *total_weight = total;
+
+  const float* r = color;
+  const float* g = color + n;
+  const float* b = color + n * 2;
+
+  if (k == 1.0f) {
+
+    /* The average may still hold anything, such as the caller's uninitialized memory, so it is not read. */
+
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+      rgb[i * 3 + 0] = r[i];
+      rgb[i * 3 + 1] = g[i];
+      rgb[i * 3 + 2] = b[i];
+    }
+
+    return;
+  }
+
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++) {
+    float* dst = rgb + i * 3;
+    dst[0] += (r[i] - dst[0]) * k;
+    dst[1] += (g[i] - dst[1]) * k;
+    dst[2] += (b[i] - dst[2]) * k;
+  }
+}
+
+void
+rg_pipeline_publish(struct rg_pipeline* self)
+{
+  struct color_buffer* written = &self->buffers[self->write_index];
+
+  written->width = self->width;
+  written->height = self->height;
+
+  pthread_mutex_lock(&self->lock);
+
+  const int published = self->write_index;
+
+  self->write_index = self->ready_index;
+  self->ready_index = published;
+  self->ready_is_new = 1;
+  self->frame_index++;
+
+  pthread_cond_signal(&self->ready_cond);
+
+  pthread_mutex_unlock(&self->lock);
+
+  /* With adaptive sampling, converged pixels are no longer written, so the next buffer has to start out with the mean
+   * colors of the frame that was just published. That buffer is only read by the present thread in the meantime. */
+
+  if (self->stats) {
+    const size_t n = (size_t)written->width * (size_t)written->height * 3u;
+    memcpy(self->buffers[self->write_index].data, self->buffers[published].data, sizeof(float) * n);
+  }
+}
+
+int
+rg_pipeline_acquire_frame(struct rg_pipeline* self, const double timeout)
+{
+  pthread_mutex_lock(&self->lock);
+
+  if (!self->ready_is_new && (timeout > 0.0)) {
+
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    const double seconds = floor(timeout);
+
+    deadline.tv_sec += (time_t)seconds;
+    deadline.tv_nsec += (long)((timeout - seconds) * 1.0e9);
+
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec += 1;
+      deadline.tv_nsec -= 1000000000L;
+    }
+
+    while (!self->ready_is_new) {
+      if (pthread_cond_timedwait(&self->ready_cond, &self->lock, &deadline) == ETIMEDOUT) {
+        break;
+      }
+    }
+  }
+
+  const int is_new = self->ready_is_new;
+
+  if (is_new) {
+    const int ready = self->ready_index;
+    self->ready_index = self->present_index;
+    self->present_index = ready;
+    self->ready_is_new = 0;
+  }
+
+  pthread_mutex_unlock(&self->lock);
+
+  return is_new;
+}
+
+void
+rg_pipeline_present_size(const struct rg_pipeline* self, int* w, int* h)
+{
+  *w = self->buffers[self->present_index].width;
+  *h = self->buffers[self->present_index].height;
+}
+
+#ifdef RAYGUN_GL
+/**
+ * @brief Converts a frame to the format that it is uploaded in.
+ * */
+static void
+convert_frame(const struct rg_pipeline* self, const struct color_buffer* buffer, const size_t num_pixels, void* dst)
+{
+  const float* planes = buffer->data;
+
+  if (self->cpu_resolve) {
+    memcpy(dst, buffer->rgba8, num_pixels * 4);
+  } else if (self->interleaved && self->half_float) {
+    rg_interleave_rgba16f(planes, num_pixels, (uint16_t*)dst);
+  } else if (self->interleaved) {
+    rg_interleave_rgba32f(planes, num_pixels, (float*)dst);
+  } else if (self->half_float) {
+    rg_convert_f16(planes, num_pixels * 3, (uint16_t*)dst);
+  } else {
+    memcpy(dst, planes, sizeof(float) * num_pixels * 3);
+  }
+}
+
+/**
+ * @brief Uploads a frame to the color textures.
+ *
+ * @param base The address of the frame, in the format given by @ref convert_frame. If a pixel unpack buffer is bound,
+ *             this is an offset into the buffer.
+ * */
+static void
+upload_textures(struct rg_pipeline* self, const uintptr_t base, const int w, const int h)
+{
+  if (self->cpu_resolve) {
+    glBindTexture(GL_TEXTURE_2D, self->textures[0]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)base);
+    return;
+  }
+
+  const GLenum type = self->half_float ? GL_HALF_FLOAT : GL_FLOAT;
+
+  if (self->interleaved) {
+    glBindTexture(GL_TEXTURE_2D, self->textures[0]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, type, (const void*)base);
+    return;
+  }
+
+  const size_t stride = (self->upload_pixel_size / 3) * (size_t)w * (size_t)h;
+
+  const GLenum format = self->half_float ? GL_RED : GL_ALPHA;
 
   for (int i = 0; i < 3; i++) {
 
     glBindTexture(GL_TEXTURE_2D, self->textures[i]);
 
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, self->width, self->height, GL_ALPHA, GL_FLOAT, ptr);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, type, (const void*)(base + stride * (size_t)i));
+  }
+}
+
+void
+rg_pipeline_sync_textures(struct rg_pipeline* self)
+{
+  const struct color_buffer* buffer = &self->buffers[self->present_index];
+
+  const size_t num_pixels = (size_t)buffer->width * (size_t)buffer->height;
+
+  const size_t size = self->upload_pixel_size * num_pixels;
+
+  const int index = self->upload_next;
 
-    ptr += stride;
+  self->upload_next = (index + 1) % UPLOAD_RING_SIZE;
+
+  /* The buffer was last used three frames ago, so the GPU has normally finished copying out of it by now. Only then
+   * can it be mapped without synchronization. If the wait fails, the driver has to synchronize the mapping instead. */
+
+  GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+
+  if (self->upload_fences[index]) {
+
+    GLenum result = glClientWaitSync(self->upload_fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, UPLOAD_WAIT_TIMEOUT);
+
+    while (result == GL_TIMEOUT_EXPIRED) {
+      result = glClientWaitSync(self->upload_fences[index], 0, UPLOAD_WAIT_TIMEOUT);
+    }
+
+    if (result == GL_WAIT_FAILED) {
+      access &= ~(GLbitfield)GL_MAP_UNSYNCHRONIZED_BIT;
+    }
   }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, self->upload_buffers[index]);
+
+  void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)size, access);
+
+  /* Either the fence has signaled, or the synchronized mapping waited for the upload that it guarded. */
+
+  if (self->upload_fences[index]) {
+    glDeleteSync(self->upload_fences[index]);
+    self->upload_fences[index] = NULL;
+  }
+
+  int mapped_ok = 0;
+
+  if (mapped) {
+    convert_frame(self, buffer, num_pixels, mapped);
+    mapped_ok = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+  }
+
+  if (!mapped_ok) {
+
+    /* The buffer could not be mapped, or its contents were lost while it was, so upload from client memory instead. */
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (self->cpu_resolve) {
+      upload_textures(self, (uintptr_t)buffer->rgba8, buffer->width, buffer->height);
+    } else if (self->staging) {
+      convert_frame(self, buffer, num_pixels, self->staging);
+      upload_textures(self, (uintptr_t)self->staging, buffer->width, buffer->height);
+    } else {
+      upload_textures(self, (uintptr_t)buffer->data, buffer->width, buffer->height);
+    }
+
+    return;
+  }
+
+  /* With an unpack buffer bound, the pointer is an offset into the buffer, and the copy into the textures is queued
+   * instead of being done right away. */
+
+  upload_textures(self, 0, buffer->width, buffer->height);
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  self->upload_fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 }
 
 void
 rg_pipeline_bind_textures(struct rg_pipeline* self, const int texture_unit_offset)
 {
-  for (int i = 0; i < 3; i++) {
+  for (int i = 0; i < self->num_textures; i++) {
 
     glActiveTexture((GLenum)(GL_TEXTURE0 + i + texture_unit_offset));
 
@@ -187,11 +1322,12 @@ rg_pipeline_bind_textures(struct rg_pipeline* self, const int texture_unit_offse
 
   glBindTexture(GL_TEXTURE_2D, rg_framebuffer_texture(rg_get_read_framebuffer(self, self->accumulate_fb)));
 }
+#endif
 
 void
 rg_pipeline_next_frame(struct rg_pipeline* self)
 {
-  self->frame_index += 1;
+  self->present_count += 1;
 }
 
 uint32_t
@@ -1,33 +1,226 @@
 #pragma once
 
+#include <raygun.h>
+
 #include <stdint.h>
 
+/**
+ * @brief The color buffers and textures that frames pass through on their way to the screen.
+ *
+ * @details The pipeline is shared by two threads. The render thread writes each frame into a color buffer and then
+ *          publishes it, and the present thread acquires the latest published frame, uploads it and draws it. There
+ *          are three color buffers, so that neither thread ever waits for the other: if the render thread publishes
+ *          frames faster than they are presented, the frames in between are skipped.
+ *
+ *          The functions that concern the render resolution, adaptive sampling and the color buffer are only called
+ *          by the render thread. The functions that touch OpenGL are only called by the present thread.
+ * */
 struct rg_pipeline;
-struct rg_random;
 
+/**
+ * @brief Creates the pipeline, without any OpenGL objects. For presenting, @ref rg_pipeline_setup_textures is called
+ *        afterwards.
+ *
+ * @param w The initial output size, which can later be changed with @ref rg_pipeline_reserve and @ref
+ *          rg_pipeline_set_output_size.
+ *
+ * @param config Gives the layout and precision of the color textures. The color buffers are always planar and in
+ *               single precision.
+ * */
 struct rg_pipeline*
-rg_pipeline_new(int w, int h);
+rg_pipeline_new(int w, int h, const struct raygun_config* config);
 
 void
 rg_pipeline_delete(struct rg_pipeline* self);
 
+#ifdef RAYGUN_GL
+/**
+ * @brief Creates the textures, upload buffers and framebuffers that frames are presented through. This has to be
+ *        called by the present thread, with the OpenGL context current.
+ *
+ * @return Zero on success, or -1 if a framebuffer could not be created.
+ * */
+int
+rg_pipeline_setup_textures(struct rg_pipeline* self);
+#endif
+
+/**
+ * @brief Gets the color buffer that the current frame is rendered into.
+ * */
 float*
 rg_pipeline_color_buffer(struct rg_pipeline* self);
 
-struct rg_random*
-rg_pipeline_random_buffer(struct rg_pipeline* self);
-
+/**
+ * @brief Gets the render resolution. The color buffer holds three planes of this size.
+ * */
 void
 rg_pipeline_size(struct rg_pipeline* self, int* w, int* h);
 
+/**
+ * @brief Gets the output size, which is the largest render resolution. This starts out as the size the pipeline was
+ *        created with, and follows the window through @ref rg_pipeline_set_output_size.
+ * */
+void
+rg_pipeline_max_size(const struct rg_pipeline* self, int* w, int* h);
+
+/**
+ * @brief Whether an output size fits in the memory and textures that are currently allocated.
+ * */
+int
+rg_pipeline_fits(const struct rg_pipeline* self, int w, int h);
+
+/**
+ * @brief Makes room for an output size, by reallocating the color buffers, textures, upload buffers and framebuffers
+ *        if the size doesn't fit. Sizes are rounded up to buckets of a few hundred pixels and never shrink, so that
+ *        dragging the edge of a window reallocates rarely, and not at all once the window is back to a size it had.
+ *
+ * @details Reallocating discards every published frame and the accumulated history. This touches OpenGL and all of
+ *          the buffers, so it is called by the present thread while the render thread is stopped.
+ *
+ * @return Zero on success, or -1 if the memory could not be allocated, in which case the pipeline can only be deleted.
+ * */
+int
+rg_pipeline_reserve(struct rg_pipeline* self, int w, int h);
+
+/**
+ * @brief Changes the output size, within the reserved size. The render resolution is scaled along with it, and the
+ *        accumulated history is discarded, since the aspect ratio of the camera changes as well. Called by the render
+ *        thread.
+ * */
+void
+rg_pipeline_set_output_size(struct rg_pipeline* self, int w, int h);
+
+/**
+ * @brief Changes the render resolution. The textures keep their size, and only the upper left part of them is used.
+ *
+ * @details With adaptive sampling, the accumulated means and statistics are resampled to the new resolution, so that
+ *          the accumulated image survives the change.
+ *
+ * @note The size is clamped to the output size.
+ *
+ * @return Zero on success, or -1 if the history could not be resampled, in which case it is discarded.
+ * */
+int
+rg_pipeline_set_render_size(struct rg_pipeline* self, int w, int h);
+
+struct rg_numa;
+
+/**
+ * @brief Moves the per-pixel memory to the NUMA nodes of the threads that render it. Each node gets the band of rows
+ *        given by @ref rg_numa_band_start. Buffers allocated later on are moved as well.
+ *
+ * @note The bands are laid out for the current render resolution. After the resolution changes, the same memory
+ *       holds other rows, so the placement only approximately matches the tiles of each node.
+ * */
+void
+rg_pipeline_set_numa(struct rg_pipeline* self, const struct rg_numa* numa);
+
+/**
+ * @brief Enables adaptive sampling. From then on, the pipeline keeps running statistics of the samples of each pixel,
+ *        and the color buffer holds the mean of all samples of a pixel instead of the samples of the last frame.
+ *
+ * @param threshold The relative standard error of a pixel's mean luminance at which the pixel is considered converged.
+ *
+ * @return Zero on success, or -1 if the statistics could not be allocated.
+ * */
+int
+rg_pipeline_enable_adaptive(struct rg_pipeline* self, float threshold);
+
+/**
+ * @brief Discards the statistics of all pixels, which makes every pixel active again.
+ * */
+void
+rg_pipeline_reset_adaptive(struct rg_pipeline* self);
+
+/**
+ * @brief Adds the average of a frame's samples of one pixel to the statistics of that pixel, and updates its mean color
+ *        in the color buffer. Only valid while adaptive sampling is enabled.
+ *
+ * @param weight The number of samples that were averaged.
+ *
+ * @return Non-zero if the pixel still needs more samples, zero if it has converged.
+ * */
+int
+rg_pipeline_add_sample(struct rg_pipeline* self, int pixel, float r, float g, float b, float weight);
+
+/**
+ * @brief Gets the mask of the pixels that still need samples, with one byte per pixel. If adaptive sampling is
+ *        disabled, this is a null pointer and every pixel is active.
+ * */
+const unsigned char*
+rg_pipeline_active_mask(const struct rg_pipeline* self);
+
+/**
+ * @brief Discards the frames accumulated on the CPU, such as after the camera changed.
+ * */
+void
+rg_pipeline_reset_accumulation(struct rg_pipeline* self);
+
+/**
+ * @brief If frames are resolved on the CPU, adds the frame in the color buffer to the accumulated frames, and tone maps
+ *        the result into the 8-bit image that is uploaded. Otherwise, this does nothing. Called by the render thread
+ *        before the frame is published.
+ *
+ * @param weight The number of samples per pixel of the frame.
+ *
+ * @param preview Non-zero if the frame is only a preview, which is shown without being accumulated.
+ * */
+void
+rg_pipeline_resolve(struct rg_pipeline* self, float weight, int preview);
+
+/**
+ * @brief Adds the frame in the color buffer to a running average of frames, for rendering without a window. Called by
+ *        the render thread before the frame is published.
+ *
+ * @param rgb The average, with three interleaved values per pixel at the render resolution.
+ *
+ * @param weight The number of samples per pixel of the frame.
+ *
+ * @param total_weight The sum of the weights of the frames in the average, which is updated. Zero to start over.
+ * */
+void
+rg_pipeline_average(struct rg_pipeline* self, float* rgb, float weight, float* total_weight);
+
+/**
+ * @brief Makes the frame in the color buffer the latest complete frame, and moves on to another color buffer for the
+ *        next frame.
+ * */
+void
+rg_pipeline_publish(struct rg_pipeline* self);
+
+/**
+ * @brief Takes the latest complete frame for presenting, if one was published since the last call.
+ *
+ * @param timeout The longest time to wait for a frame to be published, in seconds.
+ *
+ * @return Non-zero if a new frame was acquired, zero if the frame that was presented last is still the latest.
+ * */
+int
+rg_pipeline_acquire_frame(struct rg_pipeline* self, double timeout);
+
+/**
+ * @brief Gets the render resolution of the acquired frame.
+ * */
+void
+rg_pipeline_present_size(const struct rg_pipeline* self, int* w, int* h);
+
+#ifdef RAYGUN_GL
+/**
+ * @brief Uploads the acquired frame to the color textures. Depending on the texture format, the color planes are
+ *        interleaved or converted to half precision on the way.
+ * */
 void
 rg_pipeline_sync_textures(struct rg_pipeline* self);
 
 void
 rg_pipeline_bind_textures(struct rg_pipeline* self, int texture_unit_offset);
+#endif
 
 void
 rg_pipeline_next_frame(struct rg_pipeline* self);
 
+/**
+ * @brief Gets the number of frames that were published so far.
+ * */
 uint32_t
 rg_pipeline_frame_index(const struct rg_pipeline* self);
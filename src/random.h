@@ -2,11 +2,6 @@
 
 #include <stdint.h>
 
-struct rg_random
-{
-  uint32_t state;
-};
-
 #ifdef RG_RANDOM_IMPL
 
 static inline float
@@ -23,25 +18,41 @@ rg_random_floatbits(uint32_t in)
   return v.f;
 }
 
-static inline void
-rg_random_init(struct rg_random* self, const uint32_t state)
-{
-  self->state = state;
-}
-
+/**
+ * @brief A counter-based random number generator. The result is a pure function of the pixel, frame and dimension, so
+ *        there is no state to store and any sample can be reproduced on any thread.
+ *
+ * @note This is the 3D PCG hash from "Hash Functions for GPU Rendering" (Jarzynski and Olano, 2020). It only uses
+ *       32-bit integer multiplies, which keeps it cheap in vectorized loops.
+ * */
 static inline uint32_t
-rg_random_int(struct rg_random* self)
+rg_random_int(const uint32_t pixel, const uint32_t frame, const uint32_t dimension)
 {
-  self->state = self->state * 747796405u + 2891336453u;
-  const uint32_t word = ((self->state >> ((self->state >> 28u) + 4u)) ^ self->state) * 277803737u;
-  return (word >> 22u) ^ word;
+  uint32_t x = pixel * 1664525u + 1013904223u;
+  uint32_t y = frame * 1664525u + 1013904223u;
+  uint32_t z = dimension * 1664525u + 1013904223u;
+
+  x += y * z;
+  y += z * x;
+  z += x * y;
+
+  x ^= x >> 16u;
+  y ^= y >> 16u;
+  z ^= z >> 16u;
+
+  x += y * z;
+
+  return x;
 }
 
+/**
+ * @brief Gets a random number in the interval [0, 1).
+ * */
 static inline float
-rg_random_float(struct rg_random* self)
+rg_random_float(const uint32_t pixel, const uint32_t frame, const uint32_t dimension)
 {
-  const uint32_t value = rg_random_int(self);
-  return rg_random_floatbits((value & 0x007fffff) | 0x3f800000) - 1.0f;
+  const uint32_t value = rg_random_int(pixel, frame, dimension);
+  return rg_random_floatbits((value >> 9) | 0x3f800000) - 1.0f;
 }
 
 #endif /* RG_RANDOM_IMPL */
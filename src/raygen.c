@@ -0,0 +1,160 @@
+#include "raygen.h"
+
+#include "packet.h"
+
+#include <math.h>
+
+void
+rg_raygen_packet(const struct rg_raygen* self,
+                 const uint32_t n,
+                 const int x0,
+                 const int y0,
+                 struct RTCRayHitN* packet,
+                 int* valid)
+{
+  int packet_w = 1;
+  int packet_h = 1;
+  rg_packet_shape(n, &packet_w, &packet_h);
+
+  const int row_shift = (packet_w == 4) ? 2 : 1;
+
+  const struct rg_camera* camera = &self->camera;
+
+  float* org_x = rg_packet_float(packet, n, RG_PACKET_ORG_X);
+  float* org_y = rg_packet_float(packet, n, RG_PACKET_ORG_Y);
+  float* org_z = rg_packet_float(packet, n, RG_PACKET_ORG_Z);
+  float* tnear = rg_packet_float(packet, n, RG_PACKET_TNEAR);
+  float* dir_x = rg_packet_float(packet, n, RG_PACKET_DIR_X);
+  float* dir_y = rg_packet_float(packet, n, RG_PACKET_DIR_Y);
+  float* dir_z = rg_packet_float(packet, n, RG_PACKET_DIR_Z);
+  float* time = rg_packet_float(packet, n, RG_PACKET_TIME);
+  float* tfar = rg_packet_float(packet, n, RG_PACKET_TFAR);
+  uint32_t* mask = rg_packet_uint(packet, n, RG_PACKET_MASK);
+  uint32_t* id = rg_packet_uint(packet, n, RG_PACKET_ID);
+  uint32_t* flags = rg_packet_uint(packet, n, RG_PACKET_FLAGS);
+  uint32_t* geom_id = rg_packet_uint(packet, n, RG_PACKET_GEOM_ID);
+  uint32_t* inst_id = rg_packet_uint(packet, n, RG_PACKET_INST_ID);
+
+  int lane_x[RG_MAX_PACKET_SIZE] = { 0 };
+  int lane_y[RG_MAX_PACKET_SIZE] = { 0 };
+
+  for (uint32_t lane = 0; lane < n; lane++) {
+    lane_x[lane] = x0 + ((int)lane & (packet_w - 1));
+    lane_y[lane] = y0 + ((int)lane >> row_shift);
+  }
+
+  float jitter_x[RG_MAX_PACKET_SIZE];
+  float jitter_y[RG_MAX_PACKET_SIZE];
+
+  rg_sampler_generate(
+    self->sampler, (int)n, lane_x, lane_y, self->width, self->sample_index, RG_SAMPLE_DIM_PIXEL_X, jitter_x);
+
+  rg_sampler_generate(
+    self->sampler, (int)n, lane_x, lane_y, self->width, self->sample_index, RG_SAMPLE_DIM_PIXEL_Y, jitter_y);
+
+#pragma omp simd
+
+  for (uint32_t lane = 0; lane < n; lane++) {
+
+    const int x = lane_x[lane];
+    const int y = lane_y[lane];
+
+    const int inside = (x < self->width) & (y < self->height);
+
+    const float px = ((float)x) + jitter_x[lane];
+    const float py = ((float)y) + jitter_y[lane];
+
+    rg_camera_direction(camera, px, py, &dir_x[lane], &dir_y[lane], &dir_z[lane]);
+
+    org_x[lane] = camera->org[0];
+    org_y[lane] = camera->org[1];
+    org_z[lane] = camera->org[2];
+    tnear[lane] = camera->tnear;
+    tfar[lane] = inside ? camera->tfar : -INFINITY;
+    time[lane] = 0.0f;
+    mask[lane] = ~0u;
+    id[lane] = (uint32_t)(y * self->width + x);
+    flags[lane] = 0;
+    geom_id[lane] = RTC_INVALID_GEOMETRY_ID;
+    inst_id[lane] = RTC_INVALID_GEOMETRY_ID;
+
+    valid[lane] = inside ? -1 : 0;
+  }
+}
+
+void
+rg_raygen_stream(const struct rg_raygen* self,
+                 const int tile_x,
+                 const int tile_y,
+                 const struct rg_tile_item* items,
+                 const int* slots,
+                 const int count,
+                 struct RTCRayHit* rays)
+{
+  const struct rg_camera* camera = &self->camera;
+
+  /* The directions are computed in a vectorized loop over a chunk of rays, and then interleaved into the ray structures
+   * of the chunk in a second loop. */
+
+  enum
+  {
+    chunk_size = 64
+  };
+
+  int pixel_x[chunk_size];
+  int pixel_y[chunk_size];
+
+  float jitter_x[chunk_size];
+  float jitter_y[chunk_size];
+
+  float dir_x[chunk_size];
+  float dir_y[chunk_size];
+  float dir_z[chunk_size];
+
+  for (int first = 0; first < count; first += chunk_size) {
+
+    const int chunk = ((count - first) < chunk_size) ? (count - first) : chunk_size;
+
+    for (int i = 0; i < chunk; i++) {
+      const struct rg_tile_item* item = &items[slots[first + i]];
+      pixel_x[i] = tile_x + item->x;
+      pixel_y[i] = tile_y + item->y;
+    }
+
+    rg_sampler_generate(
+      self->sampler, chunk, pixel_x, pixel_y, self->width, self->sample_index, RG_SAMPLE_DIM_PIXEL_X, jitter_x);
+
+    rg_sampler_generate(
+      self->sampler, chunk, pixel_x, pixel_y, self->width, self->sample_index, RG_SAMPLE_DIM_PIXEL_Y, jitter_y);
+
+#pragma omp simd
+
+    for (int i = 0; i < chunk; i++) {
+
+      const float px = ((float)pixel_x[i]) + jitter_x[i];
+      const float py = ((float)pixel_y[i]) + jitter_y[i];
+
+      rg_camera_direction(camera, px, py, &dir_x[i], &dir_y[i], &dir_z[i]);
+    }
+
+    for (int i = 0; i < chunk; i++) {
+
+      struct RTCRayHit* ray_hit = &rays[first + i];
+
+      ray_hit->ray.org_x = camera->org[0];
+      ray_hit->ray.org_y = camera->org[1];
+      ray_hit->ray.org_z = camera->org[2];
+      ray_hit->ray.tnear = camera->tnear;
+      ray_hit->ray.dir_x = dir_x[i];
+      ray_hit->ray.dir_y = dir_y[i];
+      ray_hit->ray.dir_z = dir_z[i];
+      ray_hit->ray.time = 0.0f;
+      ray_hit->ray.tfar = camera->tfar;
+      ray_hit->ray.mask = ~0u;
+      ray_hit->ray.id = (uint32_t)(pixel_y[i] * self->width + pixel_x[i]);
+      ray_hit->ray.flags = 0;
+      ray_hit->hit.geomID = RTC_INVALID_GEOMETRY_ID;
+      ray_hit->hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "camera.h"
+#include "sampler.h"
+#include "tile.h"
+
+#include <embree3/rtcore.h>
+
+#include <stdint.h>
+
+/**
+ * @brief The state shared by the primary ray generation kernels during a frame.
+ *
+ * @details The kernels write rays directly into the layout that Embree and the trace callbacks consume. Each kernel is
+ *          a single loop over the rays it generates, including the sub-pixel jitter, which is written so that the
+ *          compiler can vectorize it at the native vector width (SSE, AVX2 or AVX-512, depending on the target).
+ *
+ *          The @p id of each ray is the index of its pixel, which the trace callbacks pass to @ref raygun_sample.
+ * */
+struct rg_raygen
+{
+  struct rg_camera camera;
+
+  /**
+   * @brief The sampler of the sub-pixel jitter.
+   * */
+  const struct rg_sampler* sampler;
+
+  /**
+   * @brief The index of the pixel sample being generated, which selects the sub-pixel jitter.
+   * */
+  uint32_t sample_index;
+
+  int width;
+
+  int height;
+};
+
+/**
+ * @brief Generates the primary rays of a packet, which covers a block of pixels.
+ *
+ * @param n The number of rays in the packet.
+ *
+ * @param x0 The column of the packet's upper left pixel.
+ *
+ * @param y0 The row of the packet's upper left pixel.
+ *
+ * @param valid Assigned the valid mask of the packet. Lanes that fall outside of the image are masked off and given an
+ *              empty ray interval, so that they never hit anything.
+ * */
+void
+rg_raygen_packet(const struct rg_raygen* self, uint32_t n, int x0, int y0, struct RTCRayHitN* packet, int* valid);
+
+/**
+ * @brief Generates a stream of single primary rays for pixels of a tile.
+ *
+ * @param items The work items of the tiling, one per pixel.
+ *
+ * @param slots The index into @p items of each ray to generate. All of the referenced pixels must be inside the image.
+ *
+ * @param count The number of rays to generate.
+ * */
+void
+rg_raygen_stream(const struct rg_raygen* self,
+                 int tile_x,
+                 int tile_y,
+                 const struct rg_tile_item* items,
+                 const int* slots,
+                 int count,
+                 struct RTCRayHit* rays);
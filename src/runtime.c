@@ -1,10 +1,19 @@
 #include "runtime.h"
 
-#define RG_RANDOM_IMPL
-
+#include "context.h"
+#include "memory.h"
+#include "numa.h"
+#include "packet.h"
 #include "pipeline.h"
+#include "raygen.h"
+#include "sampler.h"
+#include "scheduler.h"
+#include "tile.h"
+#include "wavefront.h"
+
+#ifdef RAYGUN_GL
+#include "framebuffer.h"
 #include "quad2d.h"
-#include "random.h"
 #include "shader.h"
 
 // generated
@@ -13,15 +22,28 @@
 #include <GLFW/glfw3.h>
 
 #include <glad/glad.h>
+#endif
+
+#ifdef RAYGUN_EGL
+#include "egl.h"
+#endif
 
 #include <embree3/rtcore.h>
 
+#include <omp.h>
+
+#include <pthread.h>
+
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef RAYGUN_GL
 struct accumulate_shader_info
 {
+  GLint rgb_location;
+
   GLint r_location;
 
   GLint g_location;
@@ -29,6 +51,61 @@ struct accumulate_shader_info
   GLint b_location;
 
   GLint prev_location;
+
+  GLint render_size_location;
+};
+#endif
+
+/**
+ * @brief Per-thread storage for the rays of one tile.
+ * */
+struct tile_workspace
+{
+  /**
+   * @brief The rays of the tile, as single rays or packets depending on the packet size.
+   * */
+  struct RTCRayHitN* packets;
+
+  /**
+   * @brief Holds the color planes below.
+   * */
+  float* planes;
+
+  float* r;
+
+  float* g;
+
+  float* b;
+
+  /**
+   * @brief The valid mask of each ray. Rays of packets that fall outside of the image are masked off.
+   * */
+  int* valid;
+
+  /**
+   * @brief The tile item index of each packet in @ref tile_workspace::packets.
+   * */
+  int* slots;
+
+  /**
+   * @brief Holds the color sums below.
+   * */
+  float* sum_planes;
+
+  /**
+   * @brief The sum of the colors of each ray over the samples of a frame. Only used with more than one sample per
+   *        frame.
+   * */
+  float* sum_r;
+
+  float* sum_g;
+
+  float* sum_b;
+
+  /**
+   * @brief The context passed to the trace callbacks by this thread.
+   * */
+  struct raygun_context context;
 };
 
 struct rg_runtime
@@ -37,33 +114,180 @@ struct rg_runtime
 
   const struct raygun_interface* interface;
 
+#ifdef RAYGUN_GL
   GLFWwindow* window;
 
-  RTCDevice device;
-
-  RTCScene scene;
-
   struct rg_quad2d* quad;
 
   struct rg_shader* accumulate_shader;
 
   struct rg_shader* tone_shader;
 
+  struct accumulate_shader_info accumulate_shader_info;
+
+  /**
+   * @brief The framebuffer that frames are drawn into when there is no window, or a null pointer if there is one.
+   * */
+  struct rg_framebuffer* target;
+
+  /**
+   * @brief The timings of the frame that is being presented. The acquire time adds up over the iterations that wait
+   *        for the frame.
+   * */
+  struct raygun_present_stats present_stats;
+#endif
+
+#ifdef RAYGUN_EGL
+  struct rg_egl* egl;
+#endif
+
+  RTCDevice device;
+
+  RTCScene scene;
+
   struct rg_pipeline* pipeline;
 
-  struct accumulate_shader_info accumulate_shader_info;
+  /**
+   * @brief The caller's image that frames are averaged into, when rendering without a window.
+   * */
+  float* image;
+
+  /**
+   * @brief The number of samples per pixel in @ref rg_runtime::image.
+   * */
+  float image_weight;
 
   struct raygun_camera camera;
 
+  /**
+   * @brief The number of rays per packet passed to the trace callbacks. A value of one means that the single ray
+   *        callback is used.
+   * */
+  uint32_t packet_size;
+
+  struct raygun_config config;
+
+  struct rg_tiling* tiling;
+
+  struct rg_scheduler* scheduler;
+
+  struct rg_sampler* sampler;
+
+  /**
+   * @brief The number of samples per pixel that the next frame traces.
+   * */
+  uint32_t samples_per_frame;
+
+  /**
+   * @brief The index of the next pixel sample. This advances by the number of samples traced in each frame.
+   * */
+  uint32_t sample_index;
+
+  /**
+   * @brief A running average of the time it takes to trace one sample per pixel, in seconds. Used to pick the sample
+   *        count in the automatic mode.
+   * */
+  double sample_time;
+
+  /**
+   * @brief The fraction of the window size that is rendered, along each axis.
+   * */
+  float resolution_scale;
+
+  /**
+   * @brief A running average of the time it takes to trace one sample of one pixel, in seconds. Used by the dynamic
+   *        resolution controller.
+   * */
+  double pixel_time;
+
+  /**
+   * @brief The spacing of the traced pixels in the next frame, with progressive refinement. One for full resolution.
+   * */
+  int refine_step;
+
+  /**
+   * @brief The camera of the previous frame, which is used to detect camera changes.
+   * */
+  struct raygun_camera last_camera;
+
+  int num_tiles;
+
+  /**
+   * @brief The number of pixels of each tile that still need samples. Only used with adaptive sampling.
+   * */
+  uint32_t* tile_active;
+
+  /**
+   * @brief The tiles that are rendered in the current frame. Only used with adaptive sampling.
+   * */
+  int* active_tiles;
+
+  /**
+   * @brief One workspace per render thread.
+   * */
+  struct tile_workspace* workspaces;
+
+  int num_threads;
+
+  /**
+   * @brief The NUMA topology, or a null pointer if NUMA mode is disabled.
+   * */
+  struct rg_numa* numa;
+
+  /**
+   * @brief Whether the render threads were pinned to their CPUs. This happens in the first frame, since the threads
+   *        only exist once the render thread has started its first parallel region.
+   * */
+  int threads_pinned;
+
+  /**
+   * @brief The NUMA node of each tile, in NUMA mode.
+   * */
+  int* tile_nodes;
+
+  int tile_nodes_capacity;
+
+  /**
+   * @brief Traces frames while the calling thread presents them. Only used if @ref raygun_config::async_present is
+   *        non-zero.
+   * */
+  pthread_t render_thread;
+
+  int render_thread_started;
+
+  pthread_mutex_t render_lock;
+
+  int render_lock_initialized;
+
+  /**
+   * @brief Tells the render thread to exit after its current frame. Guarded by @ref rg_runtime::render_lock.
+   * */
+  int stop_render;
+
+  /**
+   * @brief The size of the window's framebuffer, as last seen by the present thread.
+   * */
+  int window_width;
+
+  int window_height;
+
+  /**
+   * @brief The output size that the render thread is asked to switch to. Guarded by @ref rg_runtime::render_lock.
+   * */
+  int pending_width;
+
+  int pending_height;
+
+  /**
+   * @brief The output size that the render thread renders at.
+   * */
+  int output_width;
+
+  int output_height;
+
   int should_close;
 };
 
-static struct rg_runtime*
-get_runtime(GLFWwindow* window)
-{
-  return (struct rg_runtime*)glfwGetWindowUserPointer(window);
-}
-
 static void
 notify_error(struct rg_runtime* self, const char* msg)
 {
@@ -72,6 +296,13 @@ notify_error(struct rg_runtime* self, const char* msg)
   }
 }
 
+#ifdef RAYGUN_GL
+static struct rg_runtime*
+get_runtime(GLFWwindow* window)
+{
+  return (struct rg_runtime*)glfwGetWindowUserPointer(window);
+}
+
 static void
 on_glfw_key(GLFWwindow* window, const int key, const int scancode, const int action, const int mods)
 {
@@ -84,29 +315,231 @@ on_glfw_key(GLFWwindow* window, const int key, const int scancode, const int act
   (void)scancode;
   (void)mods;
 }
+#endif
+
+static int
+is_native_packet_size(RTCDevice device, const uint32_t n)
+{
+  switch (n) {
+    case 4:
+      return rtcGetDeviceProperty(device, RTC_DEVICE_PROPERTY_NATIVE_RAY4_SUPPORTED) != 0;
+    case 8:
+      return rtcGetDeviceProperty(device, RTC_DEVICE_PROPERTY_NATIVE_RAY8_SUPPORTED) != 0;
+    case 16:
+      return rtcGetDeviceProperty(device, RTC_DEVICE_PROPERTY_NATIVE_RAY16_SUPPORTED) != 0;
+  }
+  return 0;
+}
+
+static int
+has_packet_callback(const struct raygun_interface* interface, const uint32_t n)
+{
+  switch (n) {
+    case 4:
+      return interface->trace4 != NULL;
+    case 8:
+      return interface->trace8 != NULL;
+    case 16:
+      return interface->trace16 != NULL;
+  }
+  return 0;
+}
+
+/**
+ * @brief Picks the widest packet callback that the device can trace natively. If there isn't one, the single ray
+ *        callback is preferred over emulated packets. The wavefront integrator always uses single rays.
+ * */
+static uint32_t
+choose_packet_size(RTCDevice device, const struct raygun_interface* interface)
+{
+  const uint32_t sizes[3] = { 16, 8, 4 };
+
+  if (interface->shade) {
+    return 1;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    if (has_packet_callback(interface, sizes[i]) && is_native_packet_size(device, sizes[i])) {
+      return sizes[i];
+    }
+  }
+
+  if (interface->trace) {
+    return 1;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    if (has_packet_callback(interface, sizes[i])) {
+      return sizes[i];
+    }
+  }
+
+  return 1;
+}
+
+static int
+setup_workspaces(struct rg_runtime* self)
+{
+  const uint32_t n = self->packet_size;
+
+  self->num_threads = omp_get_max_threads();
+
+  self->workspaces = calloc((size_t)self->num_threads, sizeof(struct tile_workspace));
+  if (!self->workspaces) {
+    return -1;
+  }
+
+  const size_t num_items = (size_t)rg_tiling_num_items(self->tiling);
+
+  const size_t num_rays = num_items * n;
+
+  for (int i = 0; i < self->num_threads; i++) {
+
+    struct tile_workspace* ws = &self->workspaces[i];
+
+    ws->packets = rg_aligned_malloc(64, rg_packet_bytes(n) * num_items);
+    ws->planes = rg_aligned_malloc(64, sizeof(float) * num_rays * 3);
+    ws->valid = malloc(sizeof(int) * num_rays);
+    ws->slots = malloc(sizeof(int) * num_items);
+    ws->sum_planes = rg_aligned_malloc(64, sizeof(float) * num_rays * 3);
+
+    if (!ws->packets || !ws->planes || !ws->valid || !ws->slots || !ws->sum_planes) {
+      return -1;
+    }
+
+    ws->context.arena = rg_arena_new(self->config.arena_size);
+    ws->context.thread_index = (uint32_t)i;
+
+    if (!ws->context.arena) {
+      return -1;
+    }
+
+    ws->r = ws->planes;
+    ws->g = ws->r + num_rays;
+    ws->b = ws->g + num_rays;
+
+    if (self->interface->shade) {
+
+      ws->context.wavefront = rg_wavefront_new((uint32_t)num_rays, self->config.path_state_size);
+
+      if (!ws->context.wavefront) {
+        return -1;
+      }
+    }
+
+    ws->sum_r = ws->sum_planes;
+    ws->sum_g = ws->sum_r + num_rays;
+    ws->sum_b = ws->sum_g + num_rays;
+
+    if (self->numa) {
+
+      const int node = rg_numa_thread_node(self->numa, i, self->num_threads);
+
+      rg_numa_bind(self->numa, ws->packets, rg_packet_bytes(n) * num_items, node);
+      rg_numa_bind(self->numa, ws->planes, sizeof(float) * num_rays * 3, node);
+      rg_numa_bind(self->numa, ws->sum_planes, sizeof(float) * num_rays * 3, node);
+    }
+  }
+
+  return 0;
+}
+
+static void
+free_workspaces(struct rg_runtime* self)
+{
+  if (!self->workspaces) {
+    return;
+  }
+
+  for (int i = 0; i < self->num_threads; i++) {
+    rg_aligned_free(self->workspaces[i].packets);
+    rg_aligned_free(self->workspaces[i].planes);
+    rg_aligned_free(self->workspaces[i].sum_planes);
+    free(self->workspaces[i].valid);
+    free(self->workspaces[i].slots);
+    rg_wavefront_delete(self->workspaces[i].context.wavefront);
+    rg_arena_delete(self->workspaces[i].context.arena);
+  }
+
+  free(self->workspaces);
+
+  self->workspaces = NULL;
+}
+
+static int
+assign_thread_nodes(struct rg_runtime* self)
+{
+  int* thread_nodes = malloc(sizeof(int) * (size_t)self->num_threads);
+  if (!thread_nodes) {
+    return -1;
+  }
+
+  for (int i = 0; i < self->num_threads; i++) {
+    thread_nodes[i] = rg_numa_thread_node(self->numa, i, self->num_threads);
+  }
+
+  const int err = rg_scheduler_set_nodes(self->scheduler, rg_numa_num_nodes(self->numa), thread_nodes);
+
+  free(thread_nodes);
+
+  return err;
+}
 
+#ifdef RAYGUN_GL
 static void
 setup_accumulate_shader(struct rg_runtime* self)
 {
+  self->accumulate_shader_info.rgb_location = rg_shader_uniform(self->accumulate_shader, "rgb_texture");
   self->accumulate_shader_info.r_location = rg_shader_uniform(self->accumulate_shader, "r_texture");
   self->accumulate_shader_info.g_location = rg_shader_uniform(self->accumulate_shader, "g_texture");
   self->accumulate_shader_info.b_location = rg_shader_uniform(self->accumulate_shader, "b_texture");
   self->accumulate_shader_info.prev_location = rg_shader_uniform(self->accumulate_shader, "previous");
+  self->accumulate_shader_info.render_size_location = rg_shader_uniform(self->accumulate_shader, "render_size");
 }
 
-struct rg_runtime*
-rg_runtime_new(void* caller,
-               const struct raygun_interface* interface,
-               const char* window_title,
-               const char* embree_config)
+static int
+start_render_thread(struct rg_runtime* self);
+#endif
+
+/**
+ * @brief Creates the Embree device. With huge pages enabled, the setting is appended to the configuration string.
+ * */
+static RTCDevice
+new_device(const struct raygun_config* config)
 {
-  if (glfwInit() == GLFW_FALSE) {
-    if (interface->error) {
-      interface->error(caller, "Failed to initialize GLFW.");
-    }
+  if (!config->huge_pages) {
+    return rtcNewDevice(config->embree_config);
+  }
+
+  const char* base = config->embree_config ? config->embree_config : "";
+
+  const char* option = "hugepages=1";
+
+  const size_t length = strlen(base) + strlen(option) + 2;
+
+  char* device_config = malloc(length);
+  if (!device_config) {
     return NULL;
   }
 
+  snprintf(device_config, length, "%s%s%s", base, (base[0] != 0) ? "," : "", option);
+
+  RTCDevice device = rtcNewDevice(device_config);
+
+  free(device_config);
+
+  return device;
+}
+
+static void
+stop_render_thread(struct rg_runtime* self);
+
+/**
+ * @brief Allocates the runtime and fills in the settings that don't depend on any resources.
+ * */
+static struct rg_runtime*
+alloc_runtime(void* caller, const struct raygun_interface* interface, const struct raygun_config* config)
+{
   struct rg_runtime* self = malloc(sizeof(struct rg_runtime));
   if (!self) {
     if (interface->error) {
@@ -119,9 +552,139 @@ rg_runtime_new(void* caller,
 
   self->caller_data = caller;
   self->interface = interface;
+  self->config = *config;
+
+  self->samples_per_frame = (config->samples_per_frame > 0) ? config->samples_per_frame : 1;
+
+  self->resolution_scale = 1.0f;
+
+  self->refine_step = config->progressive ? 4 : 1;
 
   self->should_close = 0;
 
+  self->camera.pos[0] = 0.0f;
+  self->camera.pos[1] = 0.0f;
+  self->camera.pos[2] = 0.0f;
+
+  self->camera.dir[0] = 0.0f;
+  self->camera.dir[1] = 0.0f;
+  self->camera.dir[2] = -1.0f;
+
+  self->camera.tnear = 0.0f;
+  self->camera.tfar = 1000.0f;
+
+  return self;
+}
+
+/**
+ * @brief Sets up everything that frames are traced with, for an output of the size in @ref rg_runtime::output_width.
+ *        None of this needs OpenGL.
+ *
+ * @return Zero on success, or -1 after reporting the error.
+ * */
+static int
+setup_renderer(struct rg_runtime* self)
+{
+  const struct raygun_config* config = &self->config;
+
+  self->pending_width = self->output_width;
+  self->pending_height = self->output_height;
+
+  if (pthread_mutex_init(&self->render_lock, NULL) != 0) {
+    notify_error(self, "Failed to create the render lock.");
+    return -1;
+  }
+
+  self->render_lock_initialized = 1;
+
+  self->device = new_device(config);
+  if (!self->device) {
+    notify_error(self, "Failed to create Embree device.");
+    return -1;
+  }
+
+  self->scene = rtcNewScene(self->device);
+  if (!self->scene) {
+    notify_error(self, "Failed to create Embree scene.");
+    return -1;
+  }
+
+  self->packet_size = choose_packet_size(self->device, self->interface);
+
+  int packet_w = 1;
+  int packet_h = 1;
+  rg_packet_shape(self->packet_size, &packet_w, &packet_h);
+
+  self->tiling = rg_tiling_new(config->tile_size, config->tile_order, packet_w, packet_h);
+  if (!self->tiling) {
+    notify_error(self, "Failed to allocate screen tiles.");
+    return -1;
+  }
+
+  if (config->numa) {
+    self->numa = rg_numa_new(self->num_threads);
+    if (!self->numa) {
+      notify_error(self, "Failed to read the NUMA topology.");
+      return -1;
+    }
+  }
+
+  if (setup_workspaces(self) != 0) {
+    notify_error(self, "Failed to allocate tile workspaces.");
+    return -1;
+  }
+
+  self->scheduler = rg_scheduler_new(self->num_threads);
+  if (!self->scheduler) {
+    notify_error(self, "Failed to allocate tile scheduler.");
+    return -1;
+  }
+
+  if (self->numa && (assign_thread_nodes(self) != 0)) {
+    notify_error(self, "Failed to assign render threads to NUMA nodes.");
+    return -1;
+  }
+
+  self->sampler = rg_sampler_new(config->sampler);
+  if (!self->sampler) {
+    notify_error(self, "Failed to create sampler.");
+    return -1;
+  }
+
+  self->pipeline = rg_pipeline_new(self->output_width, self->output_height, config);
+  if (!self->pipeline) {
+    notify_error(self, "Failed to allocate pipeline.");
+    return -1;
+  }
+
+  if ((config->adaptive_threshold > 0.0f) &&
+      (rg_pipeline_enable_adaptive(self->pipeline, config->adaptive_threshold) != 0)) {
+    notify_error(self, "Failed to allocate pixel statistics.");
+    return -1;
+  }
+
+  if (self->numa) {
+    rg_pipeline_set_numa(self->pipeline, self->numa);
+  }
+
+  self->last_camera = self->camera;
+
+  if (self->interface->setup) {
+    self->interface->setup(self->caller_data, self->device, self->scene);
+  }
+
+  return 0;
+}
+
+#ifdef RAYGUN_GL
+/**
+ * @brief Creates the window and its OpenGL context, and takes the output size from the window's framebuffer.
+ *
+ * @return Zero on success, or -1 after reporting the error.
+ * */
+static int
+setup_window(struct rg_runtime* self, const char* window_title)
+{
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
   glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
@@ -133,8 +696,7 @@ rg_runtime_new(void* caller,
   if (self->window == NULL) {
     notify_error(self, "Failed to create GLFW window.");
     glfwTerminate();
-    free(self);
-    return NULL;
+    return -1;
   }
 
   glfwMakeContextCurrent(self->window);
@@ -147,80 +709,233 @@ rg_runtime_new(void* caller,
 
   glfwSetKeyCallback(self->window, on_glfw_key);
 
-  self->device = rtcNewDevice(embree_config);
-  if (!self->device) {
-    notify_error(self, "Failed to create Embree device.");
-    rg_runtime_delete(self);
-    return NULL;
-  }
+  /* On high DPI screens, the framebuffer has more pixels than the window has screen coordinates. */
+  glfwGetFramebufferSize(self->window, &self->window_width, &self->window_height);
 
-  self->scene = rtcNewScene(self->device);
-  if (!self->scene) {
-    notify_error(self, "Failed to create Embree scene.");
-    rg_runtime_delete(self);
-    return NULL;
-  }
+  self->window_width = (self->window_width > 0) ? self->window_width : init_w;
+  self->window_height = (self->window_height > 0) ? self->window_height : init_h;
+
+  self->output_width = self->window_width;
+  self->output_height = self->window_height;
+
+  return 0;
+}
+
+/**
+ * @brief Sets up the shaders and textures that frames are presented with.
+ *
+ * @return Zero on success, or -1 after reporting the error.
+ * */
+static int
+setup_presenting(struct rg_runtime* self)
+{
+  const struct raygun_config* config = &self->config;
 
   self->quad = rg_quad2d_new();
   if (!self->quad) {
     notify_error(self, "Failed to create OpenGL quad.");
-    rg_runtime_delete(self);
-    return NULL;
+    return -1;
   }
 
   self->accumulate_shader = rg_shader_new();
   if (!self->accumulate_shader) {
     notify_error(self, "Failed to create accumulate shader.");
-    rg_runtime_delete(self);
-    return NULL;
+    return -1;
   }
 
   self->tone_shader = rg_shader_new();
   if (!self->tone_shader) {
     notify_error(self, "Failed to create tone shader.");
-    rg_runtime_delete(self);
-    return NULL;
+    return -1;
   }
 
   char* shader_err = NULL;
 
-  shader_err = rg_shader_setup(self->accumulate_shader, rg_shaders_quad_vert, rg_shaders_accumulate_frag);
+  const char* accumulate_defines = "";
+
+  if (config->resolve_mode == RAYGUN_RESOLVE_CPU) {
+    accumulate_defines = "#define INTERLEAVED_COLOR 1\n#define RESOLVED_COLOR 1\n";
+  } else if (config->color_layout == RAYGUN_COLOR_LAYOUT_INTERLEAVED) {
+    accumulate_defines = "#define INTERLEAVED_COLOR 1\n";
+  }
+
+  shader_err = rg_shader_setup_with_defines(
+    self->accumulate_shader, rg_shaders_quad_vert, rg_shaders_accumulate_frag, accumulate_defines);
   if (shader_err) {
     notify_error(self, shader_err);
     rg_shader_log_free(shader_err);
-    rg_runtime_delete(self);
-    return NULL;
+    return -1;
   }
 
   shader_err = rg_shader_setup(self->tone_shader, rg_shaders_quad_vert, rg_shaders_tone_frag);
   if (shader_err) {
     notify_error(self, shader_err);
     rg_shader_log_free(shader_err);
-    rg_runtime_delete(self);
-    return NULL;
+    return -1;
   }
 
-  self->pipeline = rg_pipeline_new(init_w, init_h);
-  if (!self->pipeline) {
-    notify_error(self, "Failed to allocate pipeline.");
+  if (rg_pipeline_setup_textures(self->pipeline) != 0) {
+    notify_error(self, "Failed to allocate pipeline textures.");
+    return -1;
+  }
+
+  setup_accumulate_shader(self);
+
+  return 0;
+}
+
+struct rg_runtime*
+rg_runtime_new(void* caller,
+               const struct raygun_interface* interface,
+               const char* window_title,
+               const struct raygun_config* config)
+{
+  if (glfwInit() == GLFW_FALSE) {
+    if (interface->error) {
+      interface->error(caller, "Failed to initialize GLFW.");
+    }
+    return NULL;
+  }
+
+  struct rg_runtime* self = alloc_runtime(caller, interface, config);
+  if (!self) {
+    return NULL;
+  }
+
+  if (setup_window(self, window_title) != 0) {
+    free(self);
+    return NULL;
+  }
+
+  if ((setup_renderer(self) != 0) || (setup_presenting(self) != 0)) {
     rg_runtime_delete(self);
     return NULL;
   }
 
-  setup_accumulate_shader(self);
+  if (config->async_present && (start_render_thread(self) != 0)) {
+    notify_error(self, "Failed to start the render thread.");
+    rg_runtime_delete(self);
+    return NULL;
+  }
+
+  return self;
+}
+#endif
+
+#ifdef RAYGUN_EGL
+struct rg_runtime*
+rg_runtime_new_offscreen(void* caller,
+                         const struct raygun_interface* interface,
+                         const struct raygun_config* config,
+                         const int width,
+                         const int height)
+{
+  struct rg_runtime* self = alloc_runtime(caller, interface, config);
+  if (!self) {
+    return NULL;
+  }
+
+  self->egl = rg_egl_new();
+  if (!self->egl) {
+    notify_error(self, "Failed to create an EGL context.");
+    free(self);
+    return NULL;
+  }
+
+  self->output_width = width;
+  self->output_height = height;
+
+  if ((setup_renderer(self) != 0) || (setup_presenting(self) != 0)) {
+    rg_runtime_delete(self);
+    return NULL;
+  }
 
-  if (interface->setup) {
-    interface->setup(caller, self->device, self->scene);
+  self->target = rg_framebuffer_new_with_format(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+  if (!self->target) {
+    notify_error(self, "Failed to create the offscreen framebuffer.");
+    rg_runtime_delete(self);
+    return NULL;
+  }
+
+  glViewport(0, 0, width, height);
+
+  if (config->async_present && (start_render_thread(self) != 0)) {
+    notify_error(self, "Failed to start the render thread.");
+    rg_runtime_delete(self);
+    return NULL;
   }
 
   return self;
 }
+#endif
+
+struct rg_runtime*
+rg_runtime_new_headless(void* caller,
+                        const struct raygun_interface* interface,
+                        const struct raygun_config* config,
+                        const int width,
+                        const int height,
+                        float* image)
+{
+  struct raygun_config headless_config = *config;
+
+  /* Every frame goes into the average at full resolution, so there are no previews and no resolution changes. The
+   * color buffers are only read on the CPU, so they don't need to be converted for uploading. */
+
+  headless_config.progressive = 0;
+  headless_config.min_resolution_scale = 1.0f;
+  headless_config.async_present = 0;
+  headless_config.resolve_mode = RAYGUN_RESOLVE_GPU;
+  headless_config.color_layout = RAYGUN_COLOR_LAYOUT_PLANAR;
+  headless_config.half_float_upload = 0;
+
+  struct rg_runtime* self = alloc_runtime(caller, interface, &headless_config);
+  if (!self) {
+    return NULL;
+  }
+
+  self->output_width = width;
+  self->output_height = height;
+
+  self->image = image;
+
+  if (setup_renderer(self) != 0) {
+    rg_runtime_delete(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+/**
+ * @brief Gives the render threads back the CPU affinity that they had before they were pinned in NUMA mode. This has
+ *        to be called on the thread that rendered the frames, since the render threads are its team of OpenMP threads.
+ *        When frames are rendered on the caller's thread, that team is the caller's own.
+ * */
+static void
+unpin_threads(struct rg_runtime* self)
+{
+  if (!self->numa || !self->threads_pinned) {
+    return;
+  }
+
+#pragma omp parallel num_threads(self->num_threads)
+  {
+    rg_numa_unpin_thread(self->numa, omp_get_thread_num());
+  }
+
+  self->threads_pinned = 0;
+}
 
 void
 rg_runtime_delete(struct rg_runtime* self)
 {
   if (self) {
 
+    stop_render_thread(self);
+
+    unpin_threads(self);
+
     if (self->interface->teardown) {
       self->interface->teardown(self->caller_data, self->device, self->scene);
     }
@@ -229,6 +944,23 @@ rg_runtime_delete(struct rg_runtime* self)
       rg_pipeline_delete(self->pipeline);
     }
 
+    rg_scheduler_delete(self->scheduler);
+
+    rg_sampler_delete(self->sampler);
+
+    free(self->tile_active);
+
+    free(self->active_tiles);
+
+    free(self->tile_nodes);
+
+    rg_tiling_delete(self->tiling);
+
+    free_workspaces(self);
+
+#ifdef RAYGUN_GL
+    rg_framebuffer_delete(self->target);
+
     if (self->accumulate_shader) {
       rg_shader_delete(self->accumulate_shader);
     }
@@ -240,6 +972,7 @@ rg_runtime_delete(struct rg_runtime* self)
     if (self->quad) {
       rg_quad2d_delete(self->quad);
     }
+#endif
 
     if (self->scene) {
       rtcReleaseScene(self->scene);
@@ -249,117 +982,1151 @@ rg_runtime_delete(struct rg_runtime* self)
       rtcReleaseDevice(self->device);
     }
 
+    rg_numa_delete(self->numa);
+
+    if (self->render_lock_initialized) {
+      pthread_mutex_destroy(&self->render_lock);
+    }
+
+#ifdef RAYGUN_GL
     if (self->window) {
 
       glfwDestroyWindow(self->window);
 
       glfwTerminate();
     }
+#endif
+
+#ifdef RAYGUN_EGL
+    /* This goes last, since everything above that touches OpenGL needs the context. */
+    rg_egl_delete(self->egl);
+#endif
   }
 
   free(self);
 }
 
+struct render_info
+{
+  /**
+   * @brief The number of columns of pixels that rays are traced for. With progressive refinement, this is less than
+   *        the width of the image.
+   * */
+  int width;
+
+  int height;
+
+  /**
+   * @brief The size of the image, and of the planes of the color buffer.
+   * */
+  int image_width;
+
+  int image_height;
+
+  /**
+   * @brief The number of image pixels between traced pixels, along each axis. Each traced pixel covers a block of this
+   *        size in the image.
+   * */
+  int step;
+
+  /**
+   * @brief The ray generation state of the frame's first sample.
+   * */
+  struct rg_raygen raygen;
+
+  uint32_t samples_per_pixel;
+
+  /**
+   * @brief The pixels that still need samples, or a null pointer if every pixel does.
+   * */
+  const unsigned char* active_mask;
+
+  float* r_ptr;
+
+  float* g_ptr;
+
+  float* b_ptr;
+};
+
 static void
-rg_runtime_render(struct rg_runtime* self)
+get_render_info(struct rg_runtime* self, struct render_info* info)
 {
   int w = 0;
   int h = 0;
   rg_pipeline_size(self->pipeline, &w, &h);
 
-  const int num_pixels = w * h;
-  const float x_scale = 1.0f / ((float)w);
-  const float y_scale = 1.0f / ((float)h);
+  const int step = self->refine_step;
+
+  info->step = step;
+  info->image_width = w;
+  info->image_height = h;
+  info->width = (w + step - 1) / step;
+  info->height = (h + step - 1) / step;
+  info->r_ptr = rg_pipeline_color_buffer(self->pipeline);
+  info->g_ptr = info->r_ptr + w * h;
+  info->b_ptr = info->g_ptr + w * h;
+
+  info->raygen.sampler = self->sampler;
+  info->raygen.sample_index = self->sample_index;
+  info->raygen.width = info->width;
+  info->raygen.height = info->height;
+
+  /* The camera is set up for the whole image, and the pixel steps are then widened, so that each traced pixel lines up
+   * exactly with the block of image pixels it covers. */
+
+  rg_camera_setup(&info->raygen.camera, &self->camera, w, h);
+
+  for (int i = 0; i < 3; i++) {
+    info->raygen.camera.step_x[i] *= (float)step;
+    info->raygen.camera.step_y[i] *= (float)step;
+  }
+
+  info->samples_per_pixel = (step > 1) ? 1 : self->samples_per_frame;
+
+  info->active_mask = (step > 1) ? NULL : rg_pipeline_active_mask(self->pipeline);
+}
+
+static void
+trace_packets(struct rg_runtime* self,
+              struct raygun_context* context,
+              struct RTCRayHitN* packets,
+              const uint32_t num_packets,
+              float* r,
+              float* g,
+              float* b)
+{
+  switch (self->packet_size) {
+    case 1:
+      self->interface->trace(
+        self->caller_data, self->scene, context, num_packets, (struct RTCRayHit*)packets, r, g, b);
+      break;
+    case 4:
+      self->interface->trace4(
+        self->caller_data, self->scene, context, num_packets, (struct RTCRayHit4*)packets, r, g, b);
+      break;
+    case 8:
+      self->interface->trace8(
+        self->caller_data, self->scene, context, num_packets, (struct RTCRayHit8*)packets, r, g, b);
+      break;
+    case 16:
+      self->interface->trace16(
+        self->caller_data, self->scene, context, num_packets, (struct RTCRayHit16*)packets, r, g, b);
+      break;
+  }
+}
+
+/**
+ * @brief Generates the primary rays for the packets of a tile.
+ * */
+static void
+generate_tile_rays(const struct rg_runtime* self,
+                   const struct rg_raygen* raygen,
+                   struct tile_workspace* ws,
+                   const int tile_x,
+                   const int tile_y,
+                   const int count)
+{
+  const uint32_t n = self->packet_size;
+
+  const struct rg_tile_item* items = rg_tiling_items(self->tiling);
+
+  if (n == 1) {
+    rg_raygen_stream(raygen, tile_x, tile_y, items, ws->slots, count, (struct RTCRayHit*)ws->packets);
+    return;
+  }
+
+  for (int i = 0; i < count; i++) {
+
+    const struct rg_tile_item* item = &items[ws->slots[i]];
+
+    rg_raygen_packet(raygen,
+                     n,
+                     tile_x + item->x,
+                     tile_y + item->y,
+                     rg_packet_at(ws->packets, n, (uint32_t)i),
+                     ws->valid + (size_t)i * n);
+  }
+}
+
+/**
+ * @brief Intersects a range of the packets in a workspace. Ranges of more than one packet are intersected with the
+ *        stream functions of Embree.
+ * */
+static void
+intersect_packets(struct rg_runtime* self, struct tile_workspace* ws, const int first, const int count)
+{
+  const uint32_t n = self->packet_size;
+
+  struct RTCRayHitN* packets = rg_packet_at(ws->packets, n, (uint32_t)first);
+
+  struct RTCIntersectContext context;
+
+  rtcInitIntersectContext(&context);
+
+  context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+  if (n == 1) {
+    if (count == 1) {
+      rtcIntersect1(self->scene, &context, (struct RTCRayHit*)packets);
+    } else {
+      rtcIntersect1M(self->scene, &context, (struct RTCRayHit*)packets, (unsigned int)count, sizeof(struct RTCRayHit));
+    }
+  } else {
+    if (count == 1) {
+      rg_packet_intersect(packets, n, ws->valid + (size_t)first * n, self->scene, &context);
+    } else {
+      rtcIntersectNM(self->scene, &context, packets, n, (unsigned int)count, rg_packet_bytes(n));
+    }
+  }
+}
+
+/**
+ * @brief Adds the colors of the last traced sample of a tile to the color sums of the workspace.
+ * */
+static void
+accumulate_tile_colors(struct tile_workspace* ws, const size_t num_rays, const int first_sample)
+{
+  if (first_sample) {
+    memcpy(ws->sum_r, ws->r, sizeof(float) * num_rays);
+    memcpy(ws->sum_g, ws->g, sizeof(float) * num_rays);
+    memcpy(ws->sum_b, ws->b, sizeof(float) * num_rays);
+    return;
+  }
+
+  float* sum_r = ws->sum_r;
+  float* sum_g = ws->sum_g;
+  float* sum_b = ws->sum_b;
+
+  const float* r = ws->r;
+  const float* g = ws->g;
+  const float* b = ws->b;
+
+#pragma omp simd
+
+  for (size_t i = 0; i < num_rays; i++) {
+    sum_r[i] += r[i];
+    sum_g[i] += g[i];
+    sum_b[i] += b[i];
+  }
+}
+
+/**
+ * @brief Fills the block of image pixels covered by a traced pixel, when tracing at a reduced resolution for
+ *        progressive refinement.
+ * */
+static void
+fill_block(const struct render_info* info, const int x, const int y, const float r, const float g, const float b)
+{
+  const int x0 = x * info->step;
+  const int y0 = y * info->step;
+
+  const int x1 = ((x0 + info->step) < info->image_width) ? (x0 + info->step) : info->image_width;
+  const int y1 = ((y0 + info->step) < info->image_height) ? (y0 + info->step) : info->image_height;
+
+  for (int py = y0; py < y1; py++) {
+    for (int px = x0; px < x1; px++) {
+      const int pixel = py * info->image_width + px;
+      info->r_ptr[pixel] = r;
+      info->g_ptr[pixel] = g;
+      info->b_ptr[pixel] = b;
+    }
+  }
+}
+
+/**
+ * @brief Writes the colors of a tile's rays to the pixels they were generated for. Lanes outside of the image are
+ *        dropped. With adaptive sampling, the colors are added to the statistics of the pixels instead.
+ *
+ * @param spp The number of samples summed up in the colors.
+ *
+ * @return The number of pixels of the tile that still need samples.
+ * */
+static uint32_t
+store_tile_colors(struct rg_runtime* self,
+                  const struct render_info* info,
+                  const struct tile_workspace* ws,
+                  const float* r,
+                  const float* g,
+                  const float* b,
+                  const uint32_t spp,
+                  const int tile_x,
+                  const int tile_y,
+                  const int count)
+{
+  const uint32_t n = self->packet_size;
+
+  const float scale = 1.0f / (float)spp;
+
+  uint32_t num_active = 0;
+
+  int packet_w = 1;
+  int packet_h = 1;
+  rg_packet_shape(n, &packet_w, &packet_h);
+
+  const struct rg_tile_item* items = rg_tiling_items(self->tiling);
+
+  for (int i = 0; i < count; i++) {
+
+    const struct rg_tile_item* item = &items[ws->slots[i]];
+
+    for (uint32_t lane = 0; lane < n; lane++) {
+
+      const size_t j = (size_t)i * n + lane;
+
+      const int x = tile_x + item->x + ((int)lane & (packet_w - 1));
+      const int y = tile_y + item->y + ((int)lane / packet_w);
+
+      if ((x >= info->width) || (y >= info->height)) {
+        continue;
+      }
+
+      const int pixel = y * info->width + x;
+
+      if (info->active_mask) {
+
+        /* A packet is traced as long as any of its pixels needs samples, but the converged ones don't get more. */
+
+        if (!info->active_mask[pixel]) {
+          continue;
+        }
+
+        num_active += (uint32_t)rg_pipeline_add_sample(
+          self->pipeline, pixel, r[j] * scale, g[j] * scale, b[j] * scale, (float)spp);
+        continue;
+      }
+
+      if (info->step > 1) {
+        fill_block(info, x, y, r[j] * scale, g[j] * scale, b[j] * scale);
+        num_active++;
+        continue;
+      }
+
+      info->r_ptr[pixel] = r[j] * scale;
+      info->g_ptr[pixel] = g[j] * scale;
+      info->b_ptr[pixel] = b[j] * scale;
+
+      num_active++;
+    }
+  }
+
+  return num_active;
+}
+
+/**
+ * @brief Checks whether any pixel of a tile item that lies inside of the image still needs samples.
+ * */
+static int
+is_item_active(const struct render_info* info, const int x0, const int y0, const int item_w, const int item_h)
+{
+  for (int y = y0; (y < (y0 + item_h)) && (y < info->height); y++) {
+    for (int x = x0; (x < (x0 + item_w)) && (x < info->width); x++) {
+      if (info->active_mask[y * info->width + x]) {
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Intersects and traces the rays of a tile, either as one stream or one packet at a time, depending on the trace
+ *        mode. With the wavefront integrator, the rays start the paths of the tile instead.
+ * */
+static void
+trace_tile(struct rg_runtime* self, struct tile_workspace* ws, const int count)
+{
+  const uint32_t n = self->packet_size;
+
+  if (ws->context.wavefront) {
+    rg_wavefront_trace(ws->context.wavefront,
+                       self->interface,
+                       self->caller_data,
+                       self->scene,
+                       &ws->context,
+                       (struct RTCRayHit*)ws->packets,
+                       (uint32_t)count,
+                       ws->r,
+                       ws->g,
+                       ws->b);
+    return;
+  }
+
+  if (self->config.trace_mode == RAYGUN_TRACE_MODE_STREAM) {
+    intersect_packets(self, ws, 0, count);
+    trace_packets(self, &ws->context, ws->packets, (uint32_t)count, ws->r, ws->g, ws->b);
+    return;
+  }
+
+  for (int i = 0; i < count; i++) {
+    const size_t offset = (size_t)i * n;
+    intersect_packets(self, ws, i, 1);
+    trace_packets(self,
+                  &ws->context,
+                  rg_packet_at(ws->packets, n, (uint32_t)i),
+                  1,
+                  ws->r + offset,
+                  ws->g + offset,
+                  ws->b + offset);
+  }
+}
+
+/**
+ * @brief Renders one tile. For each sample of the frame, the rays of the whole tile are generated up front and then
+ *        traced. With more than one sample, the colors are averaged in the workspace before they are stored, so the
+ *        color buffer is written once per frame.
+ * */
+static void
+render_tile(struct rg_runtime* self, const struct render_info* info, const int tile_index, const int thread)
+{
+  const uint32_t n = self->packet_size;
+
+  struct tile_workspace* ws = &self->workspaces[thread];
+
+  int tile_x = 0;
+  int tile_y = 0;
+  rg_tiling_origin(self->tiling, info->width, tile_index, &tile_x, &tile_y);
+
+  const struct rg_tile_item* items = rg_tiling_items(self->tiling);
+
+  const int num_items = rg_tiling_num_items(self->tiling);
+
+  int count = 0;
+
+  int packet_w = 1;
+  int packet_h = 1;
+  rg_packet_shape(n, &packet_w, &packet_h);
+
+  for (int i = 0; i < num_items; i++) {
+
+    const int x = tile_x + items[i].x;
+    const int y = tile_y + items[i].y;
+
+    if ((x >= info->width) || (y >= info->height)) {
+      continue;
+    }
+
+    if (info->active_mask && !is_item_active(info, x, y, packet_w, packet_h)) {
+      continue;
+    }
+
+    ws->slots[count] = i;
+    count++;
+  }
+
+  if (count == 0) {
+    if (info->active_mask) {
+      self->tile_active[tile_index] = 0;
+    }
+    return;
+  }
+
+  const uint32_t spp = info->samples_per_pixel;
+
+  struct rg_raygen raygen = info->raygen;
+
+  ws->context.scene = self->scene;
+  ws->context.sampler = self->sampler;
+  ws->context.width = info->width;
+
+  for (uint32_t s = 0; s < spp; s++) {
+
+    raygen.sample_index = info->raygen.sample_index + s;
+
+    ws->context.sample_index = raygen.sample_index;
+
+    generate_tile_rays(self, &raygen, ws, tile_x, tile_y, count);
+
+    trace_tile(self, ws, count);
+
+    if (spp > 1) {
+      accumulate_tile_colors(ws, (size_t)count * n, s == 0);
+    }
+  }
+
+  uint32_t num_active = 0;
+
+  if (spp > 1) {
+    num_active = store_tile_colors(self, info, ws, ws->sum_r, ws->sum_g, ws->sum_b, spp, tile_x, tile_y, count);
+  } else {
+    num_active = store_tile_colors(self, info, ws, ws->r, ws->g, ws->b, 1, tile_x, tile_y, count);
+  }
+
+  if (info->active_mask) {
+    self->tile_active[tile_index] = num_active;
+  }
+}
+
+struct render_task_data
+{
+  struct rg_runtime* runtime;
+
+  const struct render_info* info;
+};
+
+static void
+render_task(void* data, const int task, const int thread)
+{
+  const struct render_task_data* task_data = (const struct render_task_data*)data;
+
+  render_tile(task_data->runtime, task_data->info, task, thread);
+}
+
+/**
+ * @brief Picks the number of samples per pixel of the next frame, when it is chosen automatically. The time per sample
+ *        is smoothed over frames, so that a single slow frame doesn't make the count jump.
+ * */
+static void
+update_samples_per_frame(struct rg_runtime* self, const double render_time)
+{
+  if (self->config.samples_per_frame > 0) {
+    return;
+  }
+
+  if (self->resolution_scale < 1.0f) {
+    /* The frame doesn't fit at full resolution, so there is no time for more samples. */
+    self->samples_per_frame = 1;
+    self->sample_time = 0.0;
+    return;
+  }
+
+  const uint32_t max_samples = 64;
 
-  struct rg_random* rng_buffer = rg_pipeline_random_buffer(self->pipeline);
+  const double sample_time = render_time / (double)self->samples_per_frame;
 
-  float* r_ptr = rg_pipeline_color_buffer(self->pipeline);
-  float* g_ptr = r_ptr + w * h;
-  float* b_ptr = g_ptr + w * h;
+  self->sample_time = (self->sample_time > 0.0) ? (self->sample_time * 0.8 + sample_time * 0.2) : sample_time;
 
-#pragma omp parallel for
+  double samples = (self->sample_time > 0.0) ? (self->config.target_frame_time / self->sample_time) : 1.0;
 
-  for (int i = 0; i < num_pixels; i++) {
+  samples = (samples < 1.0) ? 1.0 : samples;
+  samples = (samples > (double)max_samples) ? (double)max_samples : samples;
 
-    const int x = i % w;
-    const int y = i / w;
+  self->samples_per_frame = (uint32_t)samples;
+}
+
+static void
+activate_all_tiles(struct rg_runtime* self)
+{
+  for (int i = 0; i < self->num_tiles; i++) {
+    self->tile_active[i] = 1;
+  }
+}
+
+/**
+ * @brief Scales the render resolution so that a frame takes about the target frame time, when dynamic resolution is
+ *        enabled. The time per pixel sample is smoothed over frames, and small changes of the scale are ignored so
+ *        that the resolution doesn't change every frame.
+ * */
+static void
+update_resolution(struct rg_runtime* self, const struct raygun_frame_stats* stats)
+{
+  if (self->config.min_resolution_scale >= 1.0f) {
+    return;
+  }
+
+  const double pixel_samples = (double)stats->width * (double)stats->height * (double)stats->samples_per_pixel;
+  if ((pixel_samples <= 0.0) || (stats->render_time <= 0.0)) {
+    return;
+  }
+
+  const double pixel_time = stats->render_time / pixel_samples;
+
+  self->pixel_time = (self->pixel_time > 0.0) ? (self->pixel_time * 0.8 + pixel_time * 0.2) : pixel_time;
+
+  int max_w = 0;
+  int max_h = 0;
+  rg_pipeline_max_size(self->pipeline, &max_w, &max_h);
+
+  const double min_spp = (self->config.samples_per_frame > 0) ? (double)self->config.samples_per_frame : 1.0;
+
+  const double budget = self->config.target_frame_time / (self->pixel_time * min_spp);
+
+  double scale = sqrt(budget / ((double)max_w * (double)max_h));
+
+  const double min_scale = (self->config.min_resolution_scale > 0.0f) ? self->config.min_resolution_scale : 0.01;
+
+  scale = (scale < min_scale) ? min_scale : scale;
+  scale = (scale > 1.0) ? 1.0 : scale;
+
+  if (fabs(scale - (double)self->resolution_scale) < (0.05 * (double)self->resolution_scale)) {
+    return;
+  }
+
+  self->resolution_scale = (float)scale;
+
+  const int w = (int)(((double)max_w) * scale + 0.5);
+  const int h = (int)(((double)max_h) * scale + 0.5);
+
+  if (rg_pipeline_set_render_size(self->pipeline, w, h) != 0) {
+    notify_error(self, "Failed to resample the accumulated image.");
+  }
+
+  activate_all_tiles(self);
+}
+
+/**
+ * @brief Resizes the per-tile activity counts to the number of tiles in the image. When the count changes, every tile
+ *        starts out active.
+ * */
+static int
+resize_tile_lists(struct rg_runtime* self, const int num_tiles)
+{
+  if ((num_tiles == self->num_tiles) && self->tile_active) {
+    return 0;
+  }
+
+  free(self->tile_active);
+  free(self->active_tiles);
 
-    const float u = (((float)x) + rg_random_float(&rng_buffer[i])) * x_scale;
-    const float v = (((float)y) + rg_random_float(&rng_buffer[i])) * y_scale;
+  self->tile_active = malloc(sizeof(uint32_t) * (size_t)num_tiles);
+  self->active_tiles = malloc(sizeof(int) * (size_t)num_tiles);
+  self->num_tiles = 0;
 
-    const float dx = u * 2.0f - 1.0f;
-    const float dy = v * 2.0f - 1.0f;
-    const float dz = -1.0f;
+  if (!self->tile_active || !self->active_tiles) {
+    free(self->tile_active);
+    free(self->active_tiles);
+    self->tile_active = NULL;
+    self->active_tiles = NULL;
+    return -1;
+  }
+
+  for (int i = 0; i < num_tiles; i++) {
+    self->tile_active[i] = 1;
+  }
+
+  self->num_tiles = num_tiles;
+
+  return 0;
+}
+
+/**
+ * @brief Renders the tiles that contain pixels which still need samples, and counts those pixels afterwards.
+ * */
+static int
+render_active_tiles(struct rg_runtime* self, struct render_task_data* task_data, const int num_tiles)
+{
+  if (resize_tile_lists(self, num_tiles) != 0) {
+    return -1;
+  }
+
+  int count = 0;
+
+  for (int i = 0; i < num_tiles; i++) {
+    if (self->tile_active[i] > 0) {
+      self->active_tiles[count] = i;
+      count++;
+    }
+  }
+
+  return rg_scheduler_run_subset(self->scheduler, num_tiles, self->active_tiles, count, render_task, task_data);
+}
+
+/**
+ * @brief In NUMA mode, pins the render threads to their CPUs if that hasn't happened yet, and assigns each tile to the
+ *        node whose band of rows it starts in.
+ * */
+static int
+update_numa_placement(struct rg_runtime* self, const struct render_info* info, const int num_tiles)
+{
+  if (!self->numa) {
+    return 0;
+  }
 
-    const float rcp_mag = 1.0f / sqrtf(dx * dx + dy * dy + dz * dz);
+  if (!self->threads_pinned) {
+
+#pragma omp parallel num_threads(self->num_threads)
+    {
+      rg_numa_pin_thread(self->numa, omp_get_thread_num(), self->num_threads);
+    }
 
-    const float ndx = dx * rcp_mag;
-    const float ndy = dy * rcp_mag;
-    const float ndz = dz * rcp_mag;
+    self->threads_pinned = 1;
+  }
 
-    struct RTCRayHit ray_hit;
+  if (num_tiles > self->tile_nodes_capacity) {
 
-    ray_hit.ray.flags = 0;
-    ray_hit.ray.id = 0;
-    ray_hit.ray.mask = ~0u;
+    /* The scheduler may still point to the old array, so it's replaced before the old one is freed. */
 
-    ray_hit.ray.tnear = 0;
-    ray_hit.ray.tfar = 1000;
+    int* tile_nodes = malloc(sizeof(int) * (size_t)num_tiles);
+    if (!tile_nodes) {
+      return -1;
+    }
 
-    ray_hit.ray.org_x = self->camera.pos[0];
-    ray_hit.ray.org_y = self->camera.pos[1];
-    ray_hit.ray.org_z = self->camera.pos[2];
+    rg_scheduler_set_task_nodes(self->scheduler, tile_nodes);
 
-    ray_hit.ray.dir_x = ndx;
-    ray_hit.ray.dir_y = ndy;
-    ray_hit.ray.dir_z = ndz;
+    free(self->tile_nodes);
 
-    ray_hit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
-    ray_hit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+    self->tile_nodes = tile_nodes;
+    self->tile_nodes_capacity = num_tiles;
+  }
 
-    struct RTCIntersectContext context;
+  const int num_nodes = rg_numa_num_nodes(self->numa);
 
-    rtcInitIntersectContext(&context);
+  for (int i = 0; i < num_tiles; i++) {
 
-    rtcIntersect1(self->scene, &context, &ray_hit);
+    int x = 0;
+    int y = 0;
+    rg_tiling_origin(self->tiling, info->width, i, &x, &y);
 
-    self->interface->trace(self->caller_data, self->scene, 1, &ray_hit, r_ptr + i, g_ptr + i, b_ptr + i);
+    self->tile_nodes[i] = rg_numa_row_node(y, info->height, num_nodes);
   }
+
+  rg_scheduler_set_task_nodes(self->scheduler, self->tile_nodes);
+
+  return 0;
 }
 
+static void
+rg_runtime_render(struct rg_runtime* self)
+{
+  if ((self->packet_size == 1) && !self->interface->trace && !self->interface->shade) {
+    return;
+  }
+
+  struct render_info info;
+
+  get_render_info(self, &info);
+
+  struct render_task_data task_data;
+
+  task_data.runtime = self;
+  task_data.info = &info;
+
+  const int num_tiles = rg_tiling_count(self->tiling, info.width, info.height);
+
+  for (int i = 0; i < self->num_threads; i++) {
+    rg_arena_reset(self->workspaces[i].context.arena);
+  }
+
+  if (update_numa_placement(self, &info, num_tiles) != 0) {
+    notify_error(self, "Failed to allocate tile nodes.");
+    return;
+  }
+
+  /* Each refinement step has its own number of tiles, so each one keeps its own tile costs. */
+
+  int history = 0;
+
+  for (int step = info.step; step > 1; step /= 2) {
+    history++;
+  }
+
+  rg_scheduler_select_history(self->scheduler, history);
+
+  const int err = info.active_mask ? render_active_tiles(self, &task_data, num_tiles)
+                                   : rg_scheduler_run(self->scheduler, num_tiles, render_task, &task_data);
+  if (err != 0) {
+    notify_error(self, "Failed to allocate tile queues.");
+    return;
+  }
+
+  struct raygun_frame_stats stats;
+
+  rg_scheduler_stats(self->scheduler, &stats);
+
+  stats.frame_index = rg_pipeline_frame_index(self->pipeline);
+  stats.width = (uint32_t)info.width;
+  stats.height = (uint32_t)info.height;
+  stats.samples_per_pixel = info.samples_per_pixel;
+  stats.active_pixels = (uint32_t)(info.width * info.height);
+
+  if (info.active_mask) {
+    stats.active_pixels = 0;
+    for (int i = 0; i < num_tiles; i++) {
+      stats.active_pixels += self->tile_active[i];
+    }
+  }
+
+  if (self->interface->stats) {
+    self->interface->stats(self->caller_data, &stats);
+  }
+
+  rg_pipeline_resolve(self->pipeline, (float)info.samples_per_pixel, info.step > 1);
+
+  if (info.step > 1) {
+    /* Coarse frames are only a preview. They don't advance the sample sequence, and their timings say nothing about
+     * the cost of full resolution frames. */
+    self->refine_step = info.step / 2;
+    return;
+  }
+
+  self->sample_index += info.samples_per_pixel;
+
+  if (self->image) {
+    rg_pipeline_average(self->pipeline, self->image, (float)info.samples_per_pixel, &self->image_weight);
+  }
+
+  update_resolution(self, &stats);
+
+  update_samples_per_frame(self, stats.render_time);
+}
+
+#ifdef RAYGUN_GL
 static void
 rg_add_previous_render(struct rg_runtime* self)
 {
   glUseProgram(rg_shader_id(self->accumulate_shader));
 
+  glUniform1i(self->accumulate_shader_info.rgb_location, 0);
   glUniform1i(self->accumulate_shader_info.r_location, 0);
   glUniform1i(self->accumulate_shader_info.g_location, 1);
   glUniform1i(self->accumulate_shader_info.b_location, 2);
   glUniform1i(self->accumulate_shader_info.prev_location, 3);
 
+  int w = 0;
+  int h = 0;
+  rg_pipeline_present_size(self->pipeline, &w, &h);
+
+  glUniform2i(self->accumulate_shader_info.render_size_location, w, h);
+
   rg_quad2d_draw(self->quad);
 }
+#endif
 
-void
-rg_runtime_iterate(struct rg_runtime* self, int* should_close)
+/**
+ * @brief Switches to the output size that the present thread asked for, if it changed since the last frame.
+ * */
+static void
+apply_output_size(struct rg_runtime* self)
 {
-  glfwPollEvents();
+  pthread_mutex_lock(&self->render_lock);
 
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  const int w = self->pending_width;
+  const int h = self->pending_height;
+
+  pthread_mutex_unlock(&self->render_lock);
+
+  if ((w == self->output_width) && (h == self->output_height)) {
+    return;
+  }
+
+  self->output_width = w;
+  self->output_height = h;
+
+  rg_pipeline_set_output_size(self->pipeline, w, h);
+
+  activate_all_tiles(self);
+
+  self->refine_step = self->config.progressive ? 4 : 1;
+}
+
+/**
+ * @brief Traces one frame into the pipeline and publishes it. This is the part of a frame that doesn't need OpenGL.
+ * */
+static void
+render_frame(struct rg_runtime* self)
+{
+  apply_output_size(self);
+
+  if (self->interface->frame) {
+    self->interface->frame(self->caller_data, self->device, self->scene, &self->camera);
+  }
+
+  if (memcmp(&self->camera, &self->last_camera, sizeof(struct raygun_camera)) != 0) {
+
+    rg_pipeline_reset_adaptive(self->pipeline);
+
+    rg_pipeline_reset_accumulation(self->pipeline);
+
+    self->image_weight = 0.0f;
+
+    activate_all_tiles(self);
+
+    self->refine_step = self->config.progressive ? 4 : 1;
+
+    self->last_camera = self->camera;
+  }
 
   rg_runtime_render(self);
 
+  rg_pipeline_publish(self->pipeline);
+}
+
+uint32_t
+rg_runtime_run_headless(struct rg_runtime* self, const uint32_t max_frames, const double time_limit)
+{
+  const double start_time = omp_get_wtime();
+
+  uint32_t frames = 0;
+
+  while ((max_frames == 0) || (frames < max_frames)) {
+
+    if ((time_limit > 0.0) && ((omp_get_wtime() - start_time) >= time_limit)) {
+      break;
+    }
+
+    render_frame(self);
+
+    frames++;
+  }
+
+  unpin_threads(self);
+
+  return frames;
+}
+
+static void
+stop_render_thread(struct rg_runtime* self)
+{
+  if (!self->render_thread_started) {
+    return;
+  }
+
+  pthread_mutex_lock(&self->render_lock);
+
+  self->stop_render = 1;
+
+  pthread_mutex_unlock(&self->render_lock);
+
+  pthread_join(self->render_thread, NULL);
+
+  self->render_thread_started = 0;
+}
+
+#ifdef RAYGUN_GL
+static void*
+render_thread_main(void* data)
+{
+  struct rg_runtime* self = (struct rg_runtime*)data;
+
+  for (;;) {
+
+    pthread_mutex_lock(&self->render_lock);
+
+    const int stop = self->stop_render;
+
+    pthread_mutex_unlock(&self->render_lock);
+
+    if (stop) {
+      break;
+    }
+
+    render_frame(self);
+  }
+
+  unpin_threads(self);
+
+  return NULL;
+}
+
+static int
+start_render_thread(struct rg_runtime* self)
+{
+  self->stop_render = 0;
+
+  /* A new render thread gets a new team of OpenMP threads, which have to be pinned again. */
+  self->threads_pinned = 0;
+
+  if (pthread_create(&self->render_thread, NULL, render_thread_main, self) != 0) {
+    return -1;
+  }
+
+  self->render_thread_started = 1;
+
+  return 0;
+}
+
+/**
+ * @brief Follows the size of the window's framebuffer. If the pipeline has to grow, the render thread is stopped while
+ *        it is reallocated. Otherwise, the render thread picks up the new size at the start of its next frame.
+ *
+ * @return Zero on success, or -1 if the pipeline could not be reallocated or the render thread could not be restarted.
+ * */
+static int
+update_window_size(struct rg_runtime* self)
+{
+  int w = 0;
+  int h = 0;
+  glfwGetFramebufferSize(self->window, &w, &h);
+
+  /* A minimized window has an empty framebuffer, and rendering continues at the last size. */
+  if ((w < 1) || (h < 1) || ((w == self->window_width) && (h == self->window_height))) {
+    return 0;
+  }
+
+  self->window_width = w;
+  self->window_height = h;
+
+  glViewport(0, 0, w, h);
+
+  if (!rg_pipeline_fits(self->pipeline, w, h)) {
+
+    const int restart = self->render_thread_started;
+
+    stop_render_thread(self);
+
+    if (rg_pipeline_reserve(self->pipeline, w, h) != 0) {
+      return -1;
+    }
+
+    if (restart && (start_render_thread(self) != 0)) {
+      return -1;
+    }
+  }
+
+  pthread_mutex_lock(&self->render_lock);
+
+  self->pending_width = w;
+  self->pending_height = h;
+
+  pthread_mutex_unlock(&self->render_lock);
+
+  return 0;
+}
+
+/**
+ * @brief The longest time that the present thread waits for a new frame before it polls the window events again, in
+ *        seconds.
+ * */
+#define PRESENT_WAIT_TIME 0.01
+
+/**
+ * @brief Takes the latest frame, waiting briefly for one if frames are traced on the render thread, and draws it into
+ *        the window or the offscreen framebuffer.
+ *
+ * @return Non-zero if a new frame was drawn, in which case it still has to be swapped and finished with @ref
+ *         finish_present.
+ * */
+static int
+draw_next_frame(struct rg_runtime* self)
+{
+  if (!self->render_thread_started) {
+    render_frame(self);
+  }
+
+  const double t0 = omp_get_wtime();
+
+  const int is_new = rg_pipeline_acquire_frame(self->pipeline, self->render_thread_started ? PRESENT_WAIT_TIME : 0.0);
+
+  const double t1 = omp_get_wtime();
+
+  self->present_stats.acquire_time += t1 - t0;
+
+  if (!is_new) {
+    return 0;
+  }
+
+  if (self->target) {
+    rg_framebuffer_bind(self->target);
+  }
+
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
   rg_pipeline_sync_textures(self->pipeline);
 
+  const double t2 = omp_get_wtime();
+
   rg_pipeline_bind_textures(self->pipeline, 0);
 
   rg_add_previous_render(self);
 
+  const double t3 = omp_get_wtime();
+
+  int w = 0;
+  int h = 0;
+  rg_pipeline_present_size(self->pipeline, &w, &h);
+
+  self->present_stats.width = (uint32_t)w;
+  self->present_stats.height = (uint32_t)h;
+  self->present_stats.upload_time = t2 - t1;
+  self->present_stats.draw_time = t3 - t2;
+
+  return 1;
+}
+
+/**
+ * @brief Reports the timings of the frame that was just presented, and starts timing the next one.
+ *
+ * @param swap_time The time it took to swap the buffers or to finish the frame, in seconds.
+ * */
+static void
+finish_present(struct rg_runtime* self, const double swap_time)
+{
+  rg_pipeline_next_frame(self->pipeline);
+
+  self->present_stats.swap_time = swap_time;
+
+  if (self->interface->present_stats) {
+    self->interface->present_stats(self->caller_data, &self->present_stats);
+  }
+
+  const uint32_t present_index = self->present_stats.present_index + 1;
+
+  memset(&self->present_stats, 0, sizeof(self->present_stats));
+
+  self->present_stats.present_index = present_index;
+}
+
+void
+rg_runtime_iterate(struct rg_runtime* self, int* should_close)
+{
+  glfwPollEvents();
+
+  if (update_window_size(self) != 0) {
+    notify_error(self, "Failed to resize the pipeline.");
+    self->should_close = 1;
+    *should_close = 1;
+    return;
+  }
+
+  const int is_new = draw_next_frame(self);
+
   self->should_close = glfwWindowShouldClose(self->window) ? 1 : self->should_close;
 
   *should_close = self->should_close;
 
+  /* Without a new frame, the back buffer is left alone, so that presenting doesn't wait for the vertical sync. */
+  if (!is_new) {
+    return;
+  }
+
+  const double t0 = omp_get_wtime();
+
   glfwSwapBuffers(self->window);
 
-  rg_pipeline_next_frame(self->pipeline);
+  finish_present(self, omp_get_wtime() - t0);
+}
+
+#ifdef RAYGUN_EGL
+uint32_t
+rg_runtime_run_offscreen(struct rg_runtime* self,
+                         const uint32_t max_frames,
+                         const double time_limit,
+                         unsigned char* pixels)
+{
+  const double start_time = omp_get_wtime();
+
+  uint32_t frames = 0;
+
+  while ((max_frames == 0) || (frames < max_frames)) {
+
+    if ((time_limit > 0.0) && ((omp_get_wtime() - start_time) >= time_limit)) {
+      break;
+    }
+
+    if (!draw_next_frame(self)) {
+      continue;
+    }
+
+    /* There is no swap to wait on, so the frame is finished explicitly, which includes the texture upload and the
+     * draw on the GPU. */
+
+    const double t0 = omp_get_wtime();
+
+    glFinish();
+
+    finish_present(self, omp_get_wtime() - t0);
+
+    frames++;
+  }
+
+  if (pixels && (frames > 0)) {
+    rg_framebuffer_bind(self->target);
+    glReadPixels(0, 0, self->output_width, self->output_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  }
+
+  unpin_threads(self);
+
+  return frames;
 }
+#endif
+#endif
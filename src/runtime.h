@@ -4,19 +4,77 @@
 
 struct rg_runtime;
 
+#ifdef RAYGUN_GL
 struct rg_runtime*
 rg_runtime_new(void* caller_data,
                const struct raygun_interface* interface,
                const char* window_title,
-               const char* embree_config);
+               const struct raygun_config* config);
+#endif
+
+/**
+ * @brief Creates a runtime without a window or OpenGL, which averages its frames into an image on the CPU.
+ *
+ * @param image Where the frames are averaged into, with three interleaved values per pixel.
+ * */
+struct rg_runtime*
+rg_runtime_new_headless(void* caller_data,
+                        const struct raygun_interface* interface,
+                        const struct raygun_config* config,
+                        int width,
+                        int height,
+                        float* image);
 
 void
 rg_runtime_delete(struct rg_runtime* self);
 
 /**
- * @brief Iterates the pipeline by one frame.
+ * @brief Renders frames of a headless runtime on the calling thread, until either limit is reached.
+ *
+ * @param max_frames The number of frames to render, or zero for no limit.
+ *
+ * @param time_limit The time after which no more frames are started, in seconds, or zero for no limit.
+ *
+ * @return The number of frames that were rendered.
+ * */
+uint32_t
+rg_runtime_run_headless(struct rg_runtime* self, uint32_t max_frames, double time_limit);
+
+#ifdef RAYGUN_GL
+/**
+ * @brief Iterates the pipeline by one frame. If frames are traced on a render thread, this presents the latest frame it
+ *        completed, if there is a new one, and otherwise waits briefly for one.
  *
  * @param should_close Whether or not the user has requested a shutdown.
  * */
 void
 rg_runtime_iterate(struct rg_runtime* self, int* should_close);
+#endif
+
+#ifdef RAYGUN_EGL
+/**
+ * @brief Creates a runtime that presents frames through the whole OpenGL pipeline, but into an offscreen framebuffer
+ *        of an EGL context instead of a window.
+ * */
+struct rg_runtime*
+rg_runtime_new_offscreen(void* caller_data,
+                         const struct raygun_interface* interface,
+                         const struct raygun_config* config,
+                         int width,
+                         int height);
+
+/**
+ * @brief Presents frames of an offscreen runtime until either limit is reached. Frames that were skipped because the
+ *        render thread was ahead don't count.
+ *
+ * @param max_frames The number of frames to present, or zero for no limit.
+ *
+ * @param time_limit The time after which no more frames are presented, in seconds, or zero for no limit.
+ *
+ * @param pixels If not a null pointer, receives the last presented frame, as 8-bit RGBA. May be a null pointer.
+ *
+ * @return The number of frames that were presented.
+ * */
+uint32_t
+rg_runtime_run_offscreen(struct rg_runtime* self, uint32_t max_frames, double time_limit, unsigned char* pixels);
+#endif
@@ -0,0 +1,416 @@
+#include "sampler.h"
+
+#define RG_RANDOM_IMPL
+
+#include "random.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The width and height of the blue noise texture. Must be a power of two.
+ * */
+#define BLUE_NOISE_SIZE 64
+
+#define BLUE_NOISE_PIXELS (BLUE_NOISE_SIZE * BLUE_NOISE_SIZE)
+
+/**
+ * @brief The distance at which the energy of a point in the blue noise pattern is cut off.
+ * */
+#define SPLAT_RADIUS 8
+
+/**
+ * @brief The generator matrices of the first four dimensions of the Sobol sequence (Joe and Kuo).
+ * */
+static const uint32_t sobol_matrices[4][32] = {
+  { 0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+    0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+    0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+    0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u },
+  { 0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+    0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+    0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+    0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu },
+  { 0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+    0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+    0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+    0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u },
+  { 0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+    0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+    0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+    0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u }
+};
+
+/**
+ * @brief The fractional parts of the R2 sequence's generators (1/g and 1/g^2, with g = 1.3247...), in 0.32 fixed point.
+ * */
+static const uint32_t r2_alpha[2] = { 3242174889u, 2447445413u };
+
+/**
+ * @brief The golden ratio in 0.32 fixed point, which is used to animate the blue noise over frames.
+ * */
+#define GOLDEN_RATIO_FIXED 2654435769u
+
+struct rg_sampler
+{
+  enum raygun_sampler_type type;
+
+  /**
+   * @brief The blue noise texture, with values in 0.32 fixed point. Only allocated by the blue noise sampler.
+   * */
+  uint32_t* blue_noise;
+};
+
+static inline float
+to_float(const uint32_t value)
+{
+  return ((float)(value >> 8)) * (1.0f / 16777216.0f);
+}
+
+static inline uint32_t
+reverse_bits(uint32_t x)
+{
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+  x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+/**
+ * @brief An Owen scramble of the bits of a value, from "Practical Hash-based Owen Scrambling" (Burley, 2020).
+ * */
+static inline uint32_t
+nested_uniform_scramble(uint32_t x, const uint32_t seed)
+{
+  x = reverse_bits(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return reverse_bits(x);
+}
+
+static inline uint32_t
+sobol(uint32_t index, const uint32_t dimension)
+{
+  uint32_t x = 0;
+
+  for (int bit = 0; bit < 32; bit++) {
+    x ^= (0u - ((index >> bit) & 1u)) & sobol_matrices[dimension][bit];
+  }
+
+  return x;
+}
+
+/**
+ * @brief An Owen-scrambled Sobol sample. Dimensions beyond the fourth are padded with independently scrambled copies of
+ *        the first four.
+ * */
+static inline uint32_t
+sample_sobol(const uint32_t pixel, const uint32_t sample, const uint32_t dimension)
+{
+  const uint32_t seed = rg_random_int(pixel, dimension / 4u, 0x50b01u);
+
+  const uint32_t index = nested_uniform_scramble(sample, seed);
+
+  const uint32_t d = dimension % 4u;
+
+  return nested_uniform_scramble(sobol(index, d), rg_random_int(seed, d, 0x50b02u));
+}
+
+/**
+ * @brief A sample of the R2 sequence, shifted by a random offset per pixel. Each pair of dimensions is a separate 2D
+ *        sequence with its own offset.
+ * */
+static inline uint32_t
+sample_r2(const uint32_t pixel, const uint32_t sample, const uint32_t dimension)
+{
+  const uint32_t offset = rg_random_int(pixel, dimension, 0x52u);
+
+  return offset + sample * r2_alpha[dimension % 2u];
+}
+
+/**
+ * @brief A sample of a tiled blue noise texture. Each dimension reads the texture at a different offset, and the values
+ *        are shifted by the golden ratio for every sample, which keeps them well distributed over the samples.
+ * */
+static inline uint32_t
+sample_blue_noise(const uint32_t* texture, const int x, const int y, const uint32_t sample, const uint32_t dimension)
+{
+  const uint32_t h = rg_random_int(dimension, 0, 0xb1u);
+
+  const uint32_t tx = ((uint32_t)x + h) & (BLUE_NOISE_SIZE - 1);
+  const uint32_t ty = ((uint32_t)y + (h >> 8)) & (BLUE_NOISE_SIZE - 1);
+
+  return texture[ty * BLUE_NOISE_SIZE + tx] + sample * GOLDEN_RATIO_FIXED;
+}
+
+/**
+ * @brief Adds or removes the energy of one point of a binary pattern, with a Gaussian falloff that wraps around the
+ *        edges of the texture. The falloff is negligible beyond @ref SPLAT_RADIUS, so only that neighborhood is
+ *        updated.
+ * */
+static void
+splat_energy(float* energy, const float* kernel, const int point, const float sign)
+{
+  const int px = point % BLUE_NOISE_SIZE;
+  const int py = point / BLUE_NOISE_SIZE;
+
+  for (int dy = -SPLAT_RADIUS; dy <= SPLAT_RADIUS; dy++) {
+
+    const int y = (py + dy) & (BLUE_NOISE_SIZE - 1);
+
+    for (int dx = -SPLAT_RADIUS; dx <= SPLAT_RADIUS; dx++) {
+
+      const int x = (px + dx) & (BLUE_NOISE_SIZE - 1);
+
+      energy[y * BLUE_NOISE_SIZE + x] +=
+        sign * kernel[(dy & (BLUE_NOISE_SIZE - 1)) * BLUE_NOISE_SIZE + (dx & (BLUE_NOISE_SIZE - 1))];
+    }
+  }
+}
+
+/**
+ * @brief Finds the point of the pattern with the given value that has the highest (or lowest) energy.
+ * */
+static int
+find_extreme(const float* energy, const unsigned char* pattern, const unsigned char value, const int highest)
+{
+  int best = -1;
+
+  for (int i = 0; i < BLUE_NOISE_PIXELS; i++) {
+
+    if (pattern[i] != value) {
+      continue;
+    }
+
+    if ((best < 0) || (highest ? (energy[i] > energy[best]) : (energy[i] < energy[best]))) {
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+/**
+ * @brief Generates the blue noise texture with the void-and-cluster method (Ulichney, 1993).
+ * */
+static int
+generate_blue_noise(uint32_t* texture)
+{
+  float* kernel = malloc(sizeof(float) * BLUE_NOISE_PIXELS);
+  float* energy = malloc(sizeof(float) * BLUE_NOISE_PIXELS);
+  unsigned char* initial = malloc(BLUE_NOISE_PIXELS);
+  unsigned char* pattern = malloc(BLUE_NOISE_PIXELS);
+
+  if (!kernel || !energy || !initial || !pattern) {
+    free(kernel);
+    free(energy);
+    free(initial);
+    free(pattern);
+    return -1;
+  }
+
+  const float sigma = 1.9f;
+
+  for (int y = 0; y < BLUE_NOISE_SIZE; y++) {
+    for (int x = 0; x < BLUE_NOISE_SIZE; x++) {
+      const int dx = (x < (BLUE_NOISE_SIZE / 2)) ? x : (BLUE_NOISE_SIZE - x);
+      const int dy = (y < (BLUE_NOISE_SIZE / 2)) ? y : (BLUE_NOISE_SIZE - y);
+      kernel[y * BLUE_NOISE_SIZE + x] = expf(-((float)(dx * dx + dy * dy)) / (2.0f * sigma * sigma));
+    }
+  }
+
+  /* Start with a random pattern and turn it into an evenly distributed one, by moving the point of the tightest
+   * cluster into the largest void until that doesn't change anything. */
+
+  memset(initial, 0, BLUE_NOISE_PIXELS);
+  memset(energy, 0, sizeof(float) * BLUE_NOISE_PIXELS);
+
+  int num_initial = 0;
+
+  for (uint32_t i = 0; num_initial < (BLUE_NOISE_PIXELS / 10); i++) {
+    const int point = (int)(rg_random_int(i, 0, 0xb10eu) % BLUE_NOISE_PIXELS);
+    if (!initial[point]) {
+      initial[point] = 1;
+      splat_energy(energy, kernel, point, 1.0f);
+      num_initial++;
+    }
+  }
+
+  for (;;) {
+
+    const int cluster = find_extreme(energy, initial, 1, 1);
+    initial[cluster] = 0;
+    splat_energy(energy, kernel, cluster, -1.0f);
+
+    const int void_point = find_extreme(energy, initial, 0, 0);
+    initial[void_point] = 1;
+    splat_energy(energy, kernel, void_point, 1.0f);
+
+    if (void_point == cluster) {
+      break;
+    }
+  }
+
+  /* Rank the initial points, removing the tightest cluster each time. */
+
+  memcpy(pattern, initial, BLUE_NOISE_PIXELS);
+
+  for (int rank = num_initial - 1; rank >= 0; rank--) {
+    const int cluster = find_extreme(energy, pattern, 1, 1);
+    pattern[cluster] = 0;
+    splat_energy(energy, kernel, cluster, -1.0f);
+    texture[cluster] = (uint32_t)rank;
+  }
+
+  /* Fill the largest voids, up to half of the texture. */
+
+  memcpy(pattern, initial, BLUE_NOISE_PIXELS);
+  memset(energy, 0, sizeof(float) * BLUE_NOISE_PIXELS);
+
+  for (int i = 0; i < BLUE_NOISE_PIXELS; i++) {
+    if (pattern[i]) {
+      splat_energy(energy, kernel, i, 1.0f);
+    }
+  }
+
+  for (int rank = num_initial; rank < (BLUE_NOISE_PIXELS / 2); rank++) {
+    const int void_point = find_extreme(energy, pattern, 0, 0);
+    pattern[void_point] = 1;
+    splat_energy(energy, kernel, void_point, 1.0f);
+    texture[void_point] = (uint32_t)rank;
+  }
+
+  /* For the second half, the remaining empty points are the minority. Their tightest cluster is filled first. */
+
+  memset(energy, 0, sizeof(float) * BLUE_NOISE_PIXELS);
+
+  for (int i = 0; i < BLUE_NOISE_PIXELS; i++) {
+    if (!pattern[i]) {
+      splat_energy(energy, kernel, i, 1.0f);
+    }
+  }
+
+  for (int rank = BLUE_NOISE_PIXELS / 2; rank < BLUE_NOISE_PIXELS; rank++) {
+    const int cluster = find_extreme(energy, pattern, 0, 1);
+    pattern[cluster] = 1;
+    splat_energy(energy, kernel, cluster, -1.0f);
+    texture[cluster] = (uint32_t)rank;
+  }
+
+  /* Convert the ranks to 0.32 fixed point, centered in each interval. */
+
+  for (int i = 0; i < BLUE_NOISE_PIXELS; i++) {
+    texture[i] = (texture[i] << 20) + (1u << 19);
+  }
+
+  free(kernel);
+  free(energy);
+  free(initial);
+  free(pattern);
+
+  return 0;
+}
+
+struct rg_sampler*
+rg_sampler_new(const enum raygun_sampler_type type)
+{
+  struct rg_sampler* self = malloc(sizeof(struct rg_sampler));
+  if (!self) {
+    return NULL;
+  }
+
+  memset(self, 0, sizeof(struct rg_sampler));
+
+  self->type = type;
+
+  if (type == RAYGUN_SAMPLER_BLUE_NOISE) {
+
+    self->blue_noise = malloc(sizeof(uint32_t) * BLUE_NOISE_PIXELS);
+
+    if (!self->blue_noise || (generate_blue_noise(self->blue_noise) != 0)) {
+      rg_sampler_delete(self);
+      return NULL;
+    }
+  }
+
+  return self;
+}
+
+void
+rg_sampler_delete(struct rg_sampler* self)
+{
+  if (self) {
+    free(self->blue_noise);
+  }
+
+  free(self);
+}
+
+float
+rg_sampler_get(const struct rg_sampler* self,
+               const int x,
+               const int y,
+               const int width,
+               const uint32_t sample,
+               const uint32_t dimension)
+{
+  const uint32_t pixel = (uint32_t)(y * width + x);
+
+  switch (self->type) {
+    case RAYGUN_SAMPLER_RANDOM:
+      break;
+    case RAYGUN_SAMPLER_SOBOL:
+      return to_float(sample_sobol(pixel, sample, dimension));
+    case RAYGUN_SAMPLER_R2:
+      return to_float(sample_r2(pixel, sample, dimension));
+    case RAYGUN_SAMPLER_BLUE_NOISE:
+      return to_float(sample_blue_noise(self->blue_noise, x, y, sample, dimension));
+  }
+
+  return to_float(rg_random_int(pixel, sample, dimension));
+}
+
+void
+rg_sampler_generate(const struct rg_sampler* self,
+                    const int count,
+                    const int* x,
+                    const int* y,
+                    const int width,
+                    const uint32_t sample,
+                    const uint32_t dimension,
+                    float* values)
+{
+  /* The sampler type is checked outside of the loops, so that each of them can be vectorized. */
+
+  switch (self->type) {
+    case RAYGUN_SAMPLER_RANDOM:
+#pragma omp simd
+      for (int i = 0; i < count; i++) {
+        values[i] = to_float(rg_random_int((uint32_t)(y[i] * width + x[i]), sample, dimension));
+      }
+      break;
+    case RAYGUN_SAMPLER_SOBOL:
+#pragma omp simd
+      for (int i = 0; i < count; i++) {
+        values[i] = to_float(sample_sobol((uint32_t)(y[i] * width + x[i]), sample, dimension));
+      }
+      break;
+    case RAYGUN_SAMPLER_R2:
+#pragma omp simd
+      for (int i = 0; i < count; i++) {
+        values[i] = to_float(sample_r2((uint32_t)(y[i] * width + x[i]), sample, dimension));
+      }
+      break;
+    case RAYGUN_SAMPLER_BLUE_NOISE:
+#pragma omp simd
+      for (int i = 0; i < count; i++) {
+        values[i] = to_float(sample_blue_noise(self->blue_noise, x[i], y[i], sample, dimension));
+      }
+      break;
+  }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <raygun.h>
+
+#include <stdint.h>
+
+/**
+ * @brief The sample dimensions used by the runtime. The dimensions from @ref RG_SAMPLE_DIM_USER onward are drawn by the
+ *        trace callbacks, through @ref raygun_sample.
+ * */
+enum rg_sample_dimension
+{
+  RG_SAMPLE_DIM_PIXEL_X,
+  RG_SAMPLE_DIM_PIXEL_Y,
+  RG_SAMPLE_DIM_USER
+};
+
+/**
+ * @brief Generates the sample values of each pixel, for each sample index and sample dimension.
+ *
+ * @details The sample index is the position in a pixel's sequence, and every pixel gets its own decorrelated copy of
+ *          the sequence. All samplers are stateless, so any sample can be evaluated on any thread.
+ * */
+struct rg_sampler;
+
+/**
+ * @brief Creates a new sampler.
+ *
+ * @note The blue noise sampler generates its noise texture here, which takes a few tens of milliseconds.
+ *
+ * @return On success, a pointer to the sampler. On failure, a null pointer.
+ * */
+struct rg_sampler*
+rg_sampler_new(enum raygun_sampler_type type);
+
+void
+rg_sampler_delete(struct rg_sampler* self);
+
+/**
+ * @brief Gets one sample value in the interval [0, 1).
+ * */
+float
+rg_sampler_get(const struct rg_sampler* self, int x, int y, int width, uint32_t sample, uint32_t dimension);
+
+/**
+ * @brief Gets the sample values of one dimension for a set of pixels.
+ *
+ * @param count The number of pixels.
+ *
+ * @param x The column of each pixel.
+ *
+ * @param y The row of each pixel.
+ *
+ * @param width The width of the image, in pixels.
+ *
+ * @param values Assigned the sample value of each pixel.
+ * */
+void
+rg_sampler_generate(const struct rg_sampler* self,
+                    int count,
+                    const int* x,
+                    const int* y,
+                    int width,
+                    uint32_t sample,
+                    uint32_t dimension,
+                    float* values);
@@ -0,0 +1,565 @@
+#include "scheduler.h"
+
+#include <omp.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+struct deque
+{
+  omp_lock_t lock;
+
+  /**
+   * @brief The index of the first task in @ref rg_scheduler::queue that is left.
+   * */
+  int head;
+
+  /**
+   * @brief One past the index of the last task in @ref rg_scheduler::queue that is left.
+   * */
+  int tail;
+};
+
+struct task_cost
+{
+  float cost;
+
+  int task;
+};
+
+/**
+ * @brief The time each task took the last time it was executed, for one kind of frame.
+ * */
+struct cost_history
+{
+  int num_tasks;
+
+  float* costs;
+};
+
+struct rg_scheduler
+{
+  int num_threads;
+
+  struct deque* deques;
+
+  struct raygun_thread_stats* thread_stats;
+
+  /**
+   * @brief The number of tasks that the task lists have room for.
+   * */
+  int task_capacity;
+
+  struct cost_history histories[RG_SCHEDULER_MAX_HISTORIES];
+
+  /**
+   * @brief The costs of the history selected with @ref rg_scheduler_select_history.
+   * */
+  float* costs;
+
+  int history;
+
+  /**
+   * @brief The tasks of all deques. Each deque owns a contiguous range of this array.
+   * */
+  int* queue;
+
+  struct task_cost* sorted;
+
+  int* owners;
+
+  double* loads;
+
+  double render_time;
+
+  int num_nodes;
+
+  /**
+   * @brief The NUMA node of each thread.
+   * */
+  int* thread_nodes;
+
+  /**
+   * @brief The threads of all nodes, one node after another.
+   * */
+  int* node_threads;
+
+  /**
+   * @brief The index of the first thread of each node in @ref rg_scheduler::node_threads, with one more entry for the
+   *        end of the last node.
+   * */
+  int* node_offsets;
+
+  /**
+   * @brief The number of tasks assigned to each node so far, for spreading tasks without a cost over its threads.
+   * */
+  int* node_counters;
+
+  struct raygun_node_stats* node_stats;
+
+  /**
+   * @brief The node of each task, or a null pointer if tasks don't belong to nodes.
+   * */
+  const int* task_nodes;
+};
+
+static void
+free_node_lists(struct rg_scheduler* self)
+{
+  free(self->thread_nodes);
+  free(self->node_threads);
+  free(self->node_offsets);
+  free(self->node_counters);
+  free(self->node_stats);
+
+  self->thread_nodes = NULL;
+  self->node_threads = NULL;
+  self->node_offsets = NULL;
+  self->node_counters = NULL;
+  self->node_stats = NULL;
+
+  self->num_nodes = 0;
+}
+
+struct rg_scheduler*
+rg_scheduler_new(const int num_threads)
+{
+  struct rg_scheduler* self = malloc(sizeof(struct rg_scheduler));
+  if (!self) {
+    return NULL;
+  }
+
+  memset(self, 0, sizeof(struct rg_scheduler));
+
+  self->num_threads = (num_threads > 0) ? num_threads : 1;
+
+  self->deques = malloc(sizeof(struct deque) * (size_t)self->num_threads);
+  self->thread_stats = calloc((size_t)self->num_threads, sizeof(struct raygun_thread_stats));
+  self->loads = malloc(sizeof(double) * (size_t)self->num_threads);
+
+  if (!self->deques || !self->thread_stats || !self->loads || (rg_scheduler_set_nodes(self, 1, NULL) != 0)) {
+    free(self->deques);
+    free(self->thread_stats);
+    free(self->loads);
+    free_node_lists(self);
+    free(self);
+    return NULL;
+  }
+
+  for (int i = 0; i < self->num_threads; i++) {
+    omp_init_lock(&self->deques[i].lock);
+    self->deques[i].head = 0;
+    self->deques[i].tail = 0;
+  }
+
+  return self;
+}
+
+static void
+free_task_lists(struct rg_scheduler* self)
+{
+  free(self->queue);
+  free(self->sorted);
+  free(self->owners);
+
+  self->queue = NULL;
+  self->sorted = NULL;
+  self->owners = NULL;
+
+  self->task_capacity = 0;
+}
+
+static void
+free_histories(struct rg_scheduler* self)
+{
+  for (int i = 0; i < RG_SCHEDULER_MAX_HISTORIES; i++) {
+    free(self->histories[i].costs);
+    self->histories[i].costs = NULL;
+    self->histories[i].num_tasks = 0;
+  }
+
+  self->costs = NULL;
+}
+
+void
+rg_scheduler_delete(struct rg_scheduler* self)
+{
+  if (self) {
+
+    for (int i = 0; i < self->num_threads; i++) {
+      omp_destroy_lock(&self->deques[i].lock);
+    }
+
+    free_task_lists(self);
+
+    free_histories(self);
+
+    free(self->deques);
+
+    free(self->thread_stats);
+
+    free(self->loads);
+
+    free_node_lists(self);
+  }
+
+  free(self);
+}
+
+int
+rg_scheduler_set_nodes(struct rg_scheduler* self, const int num_nodes, const int* thread_nodes)
+{
+  free_node_lists(self);
+
+  const size_t n = (size_t)self->num_threads;
+
+  self->thread_nodes = malloc(sizeof(int) * n);
+  self->node_threads = malloc(sizeof(int) * n);
+  self->node_offsets = calloc((size_t)num_nodes + 1, sizeof(int));
+  self->node_counters = malloc(sizeof(int) * (size_t)num_nodes);
+  self->node_stats = malloc(sizeof(struct raygun_node_stats) * (size_t)num_nodes);
+
+  if (!self->thread_nodes || !self->node_threads || !self->node_offsets || !self->node_counters || !self->node_stats) {
+    free_node_lists(self);
+    return -1;
+  }
+
+  self->num_nodes = num_nodes;
+
+  for (int i = 0; i < self->num_threads; i++) {
+    self->thread_nodes[i] = thread_nodes ? thread_nodes[i] : 0;
+    self->node_offsets[self->thread_nodes[i] + 1]++;
+  }
+
+  for (int i = 0; i < num_nodes; i++) {
+    self->node_offsets[i + 1] += self->node_offsets[i];
+    self->node_counters[i] = 0;
+  }
+
+  for (int i = 0; i < self->num_threads; i++) {
+    const int node = self->thread_nodes[i];
+    self->node_threads[self->node_offsets[node] + self->node_counters[node]] = i;
+    self->node_counters[node]++;
+  }
+
+  return 0;
+}
+
+void
+rg_scheduler_set_task_nodes(struct rg_scheduler* self, const int* task_nodes)
+{
+  self->task_nodes = task_nodes;
+}
+
+void
+rg_scheduler_select_history(struct rg_scheduler* self, const int history)
+{
+  self->history = ((history >= 0) && (history < RG_SCHEDULER_MAX_HISTORIES)) ? history : 0;
+}
+
+/**
+ * @brief Makes room for a frame of tasks. The task lists only grow, while the costs of the selected history are
+ *        discarded if its number of tasks changed.
+ * */
+static int
+resize_task_lists(struct rg_scheduler* self, const int num_tasks)
+{
+  const size_t n = (size_t)num_tasks;
+
+  if (num_tasks > self->task_capacity) {
+
+    free_task_lists(self);
+
+    self->queue = malloc(sizeof(int) * n);
+    self->sorted = malloc(sizeof(struct task_cost) * n);
+    self->owners = malloc(sizeof(int) * n);
+
+    if (!self->queue || !self->sorted || !self->owners) {
+      free_task_lists(self);
+      return -1;
+    }
+
+    self->task_capacity = num_tasks;
+  }
+
+  struct cost_history* history = &self->histories[self->history];
+
+  if (num_tasks != history->num_tasks) {
+
+    free(history->costs);
+
+    history->costs = calloc(n ? n : 1, sizeof(float));
+    history->num_tasks = 0;
+
+    if (!history->costs) {
+      self->costs = NULL;
+      return -1;
+    }
+
+    history->num_tasks = num_tasks;
+  }
+
+  self->costs = history->costs;
+
+  return 0;
+}
+
+static int
+compare_task_cost(const void* a, const void* b)
+{
+  const struct task_cost* ta = (const struct task_cost*)a;
+  const struct task_cost* tb = (const struct task_cost*)b;
+
+  if (ta->cost > tb->cost) {
+    return -1;
+  } else if (ta->cost < tb->cost) {
+    return 1;
+  }
+
+  return (ta->task < tb->task) ? -1 : ((ta->task > tb->task) ? 1 : 0);
+}
+
+/**
+ * @brief Fills the deques, assigning the most expensive tasks first to the thread with the least work so far.
+ *
+ * @param tasks The tasks to execute, or a null pointer to execute all of them.
+ *
+ * @param count The number of tasks to execute.
+ * */
+static void
+fill_deques(struct rg_scheduler* self, const int* tasks, const int count)
+{
+  for (int i = 0; i < count; i++) {
+    const int task = tasks ? tasks[i] : i;
+    self->sorted[i].cost = self->costs[task];
+    self->sorted[i].task = task;
+  }
+
+  qsort(self->sorted, (size_t)count, sizeof(struct task_cost), compare_task_cost);
+
+  for (int i = 0; i < self->num_threads; i++) {
+    self->loads[i] = 0.0;
+    self->deques[i].tail = 0;
+  }
+
+  for (int i = 0; i < self->num_nodes; i++) {
+    self->node_counters[i] = 0;
+  }
+
+  for (int i = 0; i < count; i++) {
+
+    /* A task is assigned among the threads of its node, or among all threads if it doesn't have one. */
+
+    const int node = self->task_nodes ? self->task_nodes[self->sorted[i].task] : -1;
+
+    const int* candidates = NULL;
+
+    int num_candidates = 0;
+
+    int counter = i;
+
+    if ((node >= 0) && (node < self->num_nodes)) {
+      candidates = self->node_threads + self->node_offsets[node];
+      num_candidates = self->node_offsets[node + 1] - self->node_offsets[node];
+      counter = self->node_counters[node]++;
+    }
+
+    if (num_candidates == 0) {
+      candidates = NULL;
+      num_candidates = self->num_threads;
+      counter = i;
+    }
+
+    int owner = candidates ? candidates[counter % num_candidates] : (counter % num_candidates);
+
+    if (self->sorted[i].cost > 0.0f) {
+      for (int j = 0; j < num_candidates; j++) {
+        const int thread = candidates ? candidates[j] : j;
+        if (self->loads[thread] < self->loads[owner]) {
+          owner = thread;
+        }
+      }
+    }
+
+    self->owners[i] = owner;
+    self->loads[owner] += (double)self->sorted[i].cost;
+    self->deques[owner].tail++;
+  }
+
+  /* Turn the task counts into ranges of the queue, then place the tasks in order of decreasing cost. */
+
+  int offset = 0;
+
+  for (int i = 0; i < self->num_threads; i++) {
+    const int num_owned = self->deques[i].tail;
+    self->deques[i].head = offset;
+    self->deques[i].tail = offset;
+    offset += num_owned;
+  }
+
+  for (int i = 0; i < count; i++) {
+    struct deque* d = &self->deques[self->owners[i]];
+    self->queue[d->tail] = self->sorted[i].task;
+    d->tail++;
+  }
+}
+
+static int
+pop_front(struct deque* d, const int* queue)
+{
+  int task = -1;
+
+  omp_set_lock(&d->lock);
+
+  if (d->head < d->tail) {
+    task = queue[d->head];
+    d->head++;
+  }
+
+  omp_unset_lock(&d->lock);
+
+  return task;
+}
+
+static int
+steal_back(struct deque* d, const int* queue)
+{
+  int task = -1;
+
+  omp_set_lock(&d->lock);
+
+  if (d->head < d->tail) {
+    d->tail--;
+    task = queue[d->tail];
+  }
+
+  omp_unset_lock(&d->lock);
+
+  return task;
+}
+
+/**
+ * @brief Steals a task from another thread, trying the threads of the same node before the others.
+ * */
+static int
+steal(struct rg_scheduler* self, const int thread)
+{
+  const int node = self->thread_nodes[thread];
+
+  for (int pass = 0; pass < 2; pass++) {
+
+    for (int i = 1; i < self->num_threads; i++) {
+
+      const int victim = (thread + i) % self->num_threads;
+
+      if ((self->thread_nodes[victim] == node) != (pass == 0)) {
+        continue;
+      }
+
+      const int task = steal_back(&self->deques[victim], self->queue);
+      if (task >= 0) {
+        return task;
+      }
+    }
+  }
+
+  return -1;
+}
+
+int
+rg_scheduler_run(struct rg_scheduler* self, const int num_tasks, rg_task_func func, void* data)
+{
+  return rg_scheduler_run_subset(self, num_tasks, NULL, num_tasks, func, data);
+}
+
+int
+rg_scheduler_run_subset(struct rg_scheduler* self,
+                        const int num_tasks,
+                        const int* tasks,
+                        const int count,
+                        rg_task_func func,
+                        void* data)
+{
+  if (resize_task_lists(self, num_tasks) != 0) {
+    return -1;
+  }
+
+  fill_deques(self, tasks, count);
+
+  for (int i = 0; i < self->num_threads; i++) {
+    memset(&self->thread_stats[i], 0, sizeof(struct raygun_thread_stats));
+  }
+
+  const double start_time = omp_get_wtime();
+
+#pragma omp parallel num_threads(self->num_threads)
+  {
+    const int thread = omp_get_thread_num();
+
+    struct raygun_thread_stats* stats = &self->thread_stats[thread];
+
+    for (;;) {
+
+      int task = pop_front(&self->deques[thread], self->queue);
+
+      if (task < 0) {
+
+        task = steal(self, thread);
+
+        if (task < 0) {
+          break;
+        }
+
+        stats->steals++;
+      }
+
+      const double t0 = omp_get_wtime();
+
+      func(data, task, thread);
+
+      const double t1 = omp_get_wtime();
+
+      self->costs[task] = (float)(t1 - t0);
+
+      stats->busy_time += t1 - t0;
+      stats->tiles++;
+
+      if (self->task_nodes && (self->task_nodes[task] != self->thread_nodes[thread])) {
+        stats->remote_tiles++;
+      }
+    }
+  }
+
+  self->render_time = omp_get_wtime() - start_time;
+
+  for (int i = 0; i < self->num_nodes; i++) {
+    memset(&self->node_stats[i], 0, sizeof(struct raygun_node_stats));
+  }
+
+  for (int i = 0; i < self->num_threads; i++) {
+
+    struct raygun_thread_stats* thread_stats = &self->thread_stats[i];
+
+    thread_stats->idle_time = self->render_time - thread_stats->busy_time;
+    thread_stats->node = (uint32_t)self->thread_nodes[i];
+
+    struct raygun_node_stats* node_stats = &self->node_stats[self->thread_nodes[i]];
+
+    node_stats->threads++;
+    node_stats->tiles += thread_stats->tiles;
+    node_stats->remote_tiles += thread_stats->remote_tiles;
+    node_stats->busy_time += thread_stats->busy_time;
+  }
+
+  return 0;
+}
+
+void
+rg_scheduler_stats(const struct rg_scheduler* self, struct raygun_frame_stats* stats)
+{
+  stats->render_time = self->render_time;
+  stats->num_threads = (uint32_t)self->num_threads;
+  stats->threads = self->thread_stats;
+  stats->num_nodes = (uint32_t)self->num_nodes;
+  stats->nodes = self->node_stats;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <raygun.h>
+
+/**
+ * @brief Distributes the tasks of a frame (screen tiles) among the render threads.
+ *
+ * @details Each thread owns a deque of tasks. Before a frame starts, the tasks are sorted by the time they took in the
+ *          previous frame, longest first, and assigned to the thread with the least predicted work. A thread takes
+ *          tasks from the front of its own deque, and once that's empty, it steals from the back of the other deques.
+ *
+ *          On NUMA machines, threads and tasks can be assigned to nodes. A task is then only queued for the threads of
+ *          its node, and threads steal from their own node before they turn to the others.
+ * */
+struct rg_scheduler;
+
+/**
+ * @brief The function that executes a task.
+ *
+ * @param data The pointer passed to @ref rg_scheduler_run.
+ *
+ * @param task The index of the task to execute.
+ *
+ * @param thread The index of the calling thread, which is less than the number of threads of the scheduler.
+ * */
+typedef void (*rg_task_func)(void* data, int task, int thread);
+
+/**
+ * @brief The number of separate cost histories that a scheduler keeps.
+ * */
+#define RG_SCHEDULER_MAX_HISTORIES 4
+
+struct rg_scheduler*
+rg_scheduler_new(int num_threads);
+
+void
+rg_scheduler_delete(struct rg_scheduler* self);
+
+/**
+ * @brief Assigns the threads to NUMA nodes. By default, all threads belong to a single node.
+ *
+ * @param thread_nodes The node of each thread, each less than @p num_nodes. May be a null pointer, which puts all
+ *                     threads on the first node.
+ *
+ * @return Zero on success, or -1 if memory could not be allocated, in which case the scheduler must not be used.
+ * */
+int
+rg_scheduler_set_nodes(struct rg_scheduler* self, int num_nodes, const int* thread_nodes);
+
+/**
+ * @brief Sets the node of each task for the following frames.
+ *
+ * @param task_nodes The node of each task, which must stay valid for as long as it is set and hold an entry for every
+ *                   task. May be a null pointer, which lets any thread execute any task.
+ * */
+void
+rg_scheduler_set_task_nodes(struct rg_scheduler* self, const int* task_nodes);
+
+/**
+ * @brief Selects the cost history that the following frames are ordered by and measured into. Frames with different
+ *        tasks, such as the steps of progressive refinement, keep their costs apart this way.
+ *
+ * @param history The index of the history, less than @ref RG_SCHEDULER_MAX_HISTORIES. Out of range values select the
+ *                first history.
+ * */
+void
+rg_scheduler_select_history(struct rg_scheduler* self, int history);
+
+/**
+ * @brief Executes a set of tasks and waits for all of them to finish.
+ *
+ * @note If the number of tasks differs from the previous call with the same history, the costs of that history are
+ *       discarded.
+ *
+ * @return Zero on success, or -1 if memory for the task lists could not be allocated.
+ * */
+int
+rg_scheduler_run(struct rg_scheduler* self, int num_tasks, rg_task_func func, void* data);
+
+/**
+ * @brief Executes a subset of the tasks and waits for all of them to finish. The costs of the tasks that are left out
+ *        are kept for later frames.
+ *
+ * @param num_tasks The total number of tasks.
+ *
+ * @param tasks The indices of the tasks to execute, each less than @p num_tasks.
+ *
+ * @param count The number of tasks to execute.
+ * */
+int
+rg_scheduler_run_subset(struct rg_scheduler* self,
+                        int num_tasks,
+                        const int* tasks,
+                        int count,
+                        rg_task_func func,
+                        void* data);
+
+/**
+ * @brief Gets the timing statistics of the last call to @ref rg_scheduler_run.
+ *
+ * @note The thread statistics are owned by the scheduler and remain valid until the next frame.
+ * */
+void
+rg_scheduler_stats(const struct rg_scheduler* self, struct raygun_frame_stats* stats);
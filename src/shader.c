@@ -6,11 +6,19 @@
 static char rg_shader_oom[] = "Failed to allocate log data.";
 
 static char*
-compile_shader(GLuint shader, const char* src)
+compile_shader(GLuint shader, const char* src, const char* defines)
 {
-  GLint length = (GLint)strlen(src);
+  /* The version directive has to come first, so the definitions go right after it. */
 
-  glShaderSource(shader, 1, &src, &length);
+  const char* version_end = strchr(src, '\n');
+
+  const size_t version_length = version_end ? (size_t)(version_end - src + 1) : strlen(src);
+
+  const char* sources[3] = { src, defines, src + version_length };
+
+  GLint lengths[3] = { (GLint)version_length, (GLint)strlen(defines), (GLint)strlen(src + version_length) };
+
+  glShaderSource(shader, 3, sources, lengths);
 
   glCompileShader(shader);
 
@@ -74,10 +82,19 @@ rg_shader_delete(struct rg_shader* self)
 
 char*
 rg_shader_setup(struct rg_shader* self, const char* vert_source, const char* frag_source)
+{
+  return rg_shader_setup_with_defines(self, vert_source, frag_source, "");
+}
+
+char*
+rg_shader_setup_with_defines(struct rg_shader* self,
+                             const char* vert_source,
+                             const char* frag_source,
+                             const char* defines)
 {
   GLuint vert_shader = glCreateShader(GL_VERTEX_SHADER);
 
-  char* err = compile_shader(vert_shader, vert_source);
+  char* err = compile_shader(vert_shader, vert_source, defines);
   if (err != NULL) {
     glDeleteShader(vert_shader);
     return err;
@@ -85,7 +102,7 @@ rg_shader_setup(struct rg_shader* self, const char* vert_source, const char* fra
 
   GLuint frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
 
-  err = compile_shader(frag_shader, frag_source);
+  err = compile_shader(frag_shader, frag_source, defines);
   if (err != NULL) {
     glDeleteShader(vert_shader);
     glDeleteShader(frag_shader);
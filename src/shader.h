@@ -25,6 +25,20 @@ rg_shader_delete(struct rg_shader* self);
 char*
 rg_shader_setup(struct rg_shader* self, const char* vert_source, const char* frag_source);
 
+/**
+ * @brief Compiles and links the shader, with preprocessor definitions added to both stages.
+ *
+ * @param defines Lines of preprocessor directives, such as "#define NAME\n". These are inserted after the version
+ *                directive, which must be the first line of each source.
+ *
+ * @return The same as @ref rg_shader_setup.
+ * */
+char*
+rg_shader_setup_with_defines(struct rg_shader* self,
+                             const char* vert_source,
+                             const char* frag_source,
+                             const char* defines);
+
 /**
  * @brief Gets the ID of the shader program.
  *
@@ -0,0 +1,196 @@
+#include "tile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct rg_tiling
+{
+  int tile_size;
+
+  int num_items;
+
+  struct rg_tile_item* items;
+};
+
+/**
+ * @brief The largest tile size, in pixels. Larger tiles are clamped to this, as documented in
+ *        @ref raygun_config::tile_size.
+ * */
+#define MAX_TILE_SIZE 256u
+
+static uint32_t
+round_up_pow2(uint32_t value, const uint32_t min_value)
+{
+  uint32_t result = min_value;
+
+  while ((result < value) && (result < MAX_TILE_SIZE)) {
+    result *= 2;
+  }
+
+  return result;
+}
+
+/**
+ * @brief Removes every other bit of a Morton code, leaving the bits of one coordinate.
+ * */
+static uint32_t
+morton_compact(uint32_t v)
+{
+  v &= 0x55555555u;
+  v = (v | (v >> 1)) & 0x33333333u;
+  v = (v | (v >> 2)) & 0x0f0f0f0fu;
+  v = (v | (v >> 4)) & 0x00ff00ffu;
+  v = (v | (v >> 8)) & 0x0000ffffu;
+  return v;
+}
+
+/**
+ * @brief Converts a distance along a Hilbert curve, that fills a square with the given side length, to a position.
+ * */
+static void
+hilbert_position(const uint32_t side, const uint32_t d, uint32_t* x, uint32_t* y)
+{
+  uint32_t t = d;
+
+  *x = 0;
+  *y = 0;
+
+  for (uint32_t s = 1; s < side; s *= 2) {
+
+    const uint32_t rx = 1u & (t / 2u);
+    const uint32_t ry = 1u & (t ^ rx);
+
+    if (ry == 0) {
+      if (rx == 1) {
+        *x = s - 1u - *x;
+        *y = s - 1u - *y;
+      }
+      const uint32_t tmp = *x;
+      *x = *y;
+      *y = tmp;
+    }
+
+    *x += s * rx;
+    *y += s * ry;
+
+    t /= 4u;
+  }
+}
+
+static void
+curve_position(const enum raygun_tile_order order,
+               const uint32_t cols,
+               const uint32_t side,
+               const uint32_t d,
+               uint32_t* x,
+               uint32_t* y)
+{
+  switch (order) {
+    case RAYGUN_TILE_ORDER_ROWS:
+      *x = d % cols;
+      *y = d / cols;
+      break;
+    case RAYGUN_TILE_ORDER_MORTON:
+      *x = morton_compact(d);
+      *y = morton_compact(d >> 1);
+      break;
+    case RAYGUN_TILE_ORDER_HILBERT:
+      hilbert_position(side, d, x, y);
+      break;
+  }
+}
+
+struct rg_tiling*
+rg_tiling_new(const uint32_t tile_size, const enum raygun_tile_order order, const int item_w, const int item_h)
+{
+  struct rg_tiling* self = malloc(sizeof(struct rg_tiling));
+  if (!self) {
+    return NULL;
+  }
+
+  memset(self, 0, sizeof(struct rg_tiling));
+
+  const uint32_t min_size = (uint32_t)((item_w > item_h) ? item_w : item_h);
+
+  self->tile_size = (int)round_up_pow2(tile_size, min_size);
+
+  const uint32_t cols = (uint32_t)(self->tile_size / item_w);
+  const uint32_t rows = (uint32_t)(self->tile_size / item_h);
+
+  self->num_items = (int)(cols * rows);
+
+  self->items = malloc(sizeof(struct rg_tile_item) * (size_t)self->num_items);
+  if (!self->items) {
+    free(self);
+    return NULL;
+  }
+
+  /* The curves are generated over the smallest enclosing square and the positions outside of the tile are skipped. */
+
+  const uint32_t side = (cols > rows) ? cols : rows;
+
+  int count = 0;
+
+  for (uint32_t d = 0; (d < (side * side)) && (count < self->num_items); d++) {
+
+    uint32_t x = 0;
+    uint32_t y = 0;
+    curve_position(order, cols, side, d, &x, &y);
+
+    if ((x >= cols) || (y >= rows)) {
+      continue;
+    }
+
+    self->items[count].x = (int)(x * (uint32_t)item_w);
+    self->items[count].y = (int)(y * (uint32_t)item_h);
+
+    count++;
+  }
+
+  return self;
+}
+
+void
+rg_tiling_delete(struct rg_tiling* self)
+{
+  if (self) {
+    free(self->items);
+  }
+
+  free(self);
+}
+
+int
+rg_tiling_tile_size(const struct rg_tiling* self)
+{
+  return self->tile_size;
+}
+
+int
+rg_tiling_count(const struct rg_tiling* self, const int w, const int h)
+{
+  const int tiles_x = (w + self->tile_size - 1) / self->tile_size;
+  const int tiles_y = (h + self->tile_size - 1) / self->tile_size;
+  return tiles_x * tiles_y;
+}
+
+void
+rg_tiling_origin(const struct rg_tiling* self, const int w, const int index, int* x, int* y)
+{
+  const int tiles_x = (w + self->tile_size - 1) / self->tile_size;
+
+  *x = (index % tiles_x) * self->tile_size;
+  *y = (index / tiles_x) * self->tile_size;
+}
+
+int
+rg_tiling_num_items(const struct rg_tiling* self)
+{
+  return self->num_items;
+}
+
+const struct rg_tile_item*
+rg_tiling_items(const struct rg_tiling* self)
+{
+  return self->items;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <raygun.h>
+
+#include <stdint.h>
+
+/**
+ * @brief The position of a work item (a pixel or a ray packet) relative to the origin of its tile.
+ * */
+struct rg_tile_item
+{
+  int x;
+
+  int y;
+};
+
+/**
+ * @brief Splits the image into square tiles and describes the order in which the work items inside of a tile are
+ *        visited.
+ * */
+struct rg_tiling;
+
+/**
+ * @brief Creates a new tiling.
+ *
+ * @param tile_size The width and height of a tile, in pixels. This is rounded up to a power of two that fits at least
+ *                  one work item.
+ *
+ * @param order The order of the work items inside of a tile.
+ *
+ * @param item_w The width of a work item, in pixels. Must be a power of two.
+ *
+ * @param item_h The height of a work item, in pixels. Must be a power of two.
+ *
+ * @return On success, a pointer to the tiling. On failure, a null pointer.
+ * */
+struct rg_tiling*
+rg_tiling_new(uint32_t tile_size, enum raygun_tile_order order, int item_w, int item_h);
+
+void
+rg_tiling_delete(struct rg_tiling* self);
+
+int
+rg_tiling_tile_size(const struct rg_tiling* self);
+
+/**
+ * @brief Gets the number of tiles needed to cover an image.
+ * */
+int
+rg_tiling_count(const struct rg_tiling* self, int w, int h);
+
+/**
+ * @brief Gets the pixel position of a tile's upper left corner.
+ *
+ * @param w The width of the image, in pixels.
+ *
+ * @param index The index of the tile, with tiles ordered by rows.
+ * */
+void
+rg_tiling_origin(const struct rg_tiling* self, int w, int index, int* x, int* y);
+
+/**
+ * @brief Gets the number of work items in each tile.
+ * */
+int
+rg_tiling_num_items(const struct rg_tiling* self);
+
+/**
+ * @brief Gets the work items of a tile, in the order that they are to be visited.
+ * */
+const struct rg_tile_item*
+rg_tiling_items(const struct rg_tiling* self);
@@ -0,0 +1,311 @@
+#include "wavefront.h"
+
+#include "memory.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct rg_wavefront
+{
+  uint32_t capacity;
+
+  uint32_t state_size;
+
+  /**
+   * @brief The extension rays of two bounces. One is being intersected and shaded while the other is being filled.
+   * */
+  struct RTCRayHit* queues[2];
+
+  /**
+   * @brief The path of each ray in @ref rg_wavefront::queues.
+   * */
+  uint32_t* queue_paths[2];
+
+  /**
+   * @brief The index of the queue that extension rays are emitted into.
+   * */
+  uint32_t next_queue;
+
+  uint32_t next_count;
+
+  struct RTCRay* shadow_rays;
+
+  uint32_t* shadow_paths;
+
+  /**
+   * @brief The color that each shadow ray contributes if it is unoccluded, with three values per ray.
+   * */
+  float* shadow_colors;
+
+  uint32_t shadow_count;
+
+  /**
+   * @brief The ID of the camera ray of each path, which is given to all rays of the path, so that the shade callback
+   *        can draw samples for them.
+   * */
+  uint32_t* ray_ids;
+
+  /**
+   * @brief The last bounce in which each path emitted an extension ray.
+   * */
+  uint32_t* emit_bounce;
+
+  /**
+   * @brief The path indices of the camera rays, which are simply 0, 1, 2, ...
+   * */
+  uint32_t* identity;
+
+  unsigned char* states;
+
+  uint32_t bounce;
+
+  /**
+   * @brief The number of paths being traced, which bounds the path indices passed in by the shade callback. Zero
+   *        outside of @ref rg_wavefront_trace.
+   * */
+  uint32_t num_paths;
+
+  RTCScene scene;
+
+  float* r;
+
+  float* g;
+
+  float* b;
+};
+
+struct rg_wavefront*
+rg_wavefront_new(const uint32_t capacity, const uint32_t state_size)
+{
+  struct rg_wavefront* self = malloc(sizeof(struct rg_wavefront));
+  if (!self) {
+    return NULL;
+  }
+
+  memset(self, 0, sizeof(struct rg_wavefront));
+
+  self->capacity = capacity;
+  self->state_size = state_size;
+
+  const size_t n = (size_t)capacity;
+
+  self->queues[0] = rg_aligned_malloc(64, sizeof(struct RTCRayHit) * n);
+  self->queues[1] = rg_aligned_malloc(64, sizeof(struct RTCRayHit) * n);
+  self->queue_paths[0] = malloc(sizeof(uint32_t) * n);
+  self->queue_paths[1] = malloc(sizeof(uint32_t) * n);
+  self->shadow_rays = rg_aligned_malloc(64, sizeof(struct RTCRay) * n);
+  self->shadow_paths = malloc(sizeof(uint32_t) * n);
+  self->shadow_colors = malloc(sizeof(float) * n * 3);
+  self->ray_ids = malloc(sizeof(uint32_t) * n);
+  self->emit_bounce = malloc(sizeof(uint32_t) * n);
+  self->identity = malloc(sizeof(uint32_t) * n);
+  self->states = (state_size > 0) ? malloc(n * state_size) : NULL;
+
+  if (!self->queues[0] || !self->queues[1] || !self->queue_paths[0] || !self->queue_paths[1] || !self->shadow_rays ||
+      !self->shadow_paths || !self->shadow_colors || !self->ray_ids || !self->emit_bounce || !self->identity ||
+      ((state_size > 0) && !self->states)) {
+    rg_wavefront_delete(self);
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < capacity; i++) {
+    self->identity[i] = i;
+  }
+
+  return self;
+}
+
+void
+rg_wavefront_delete(struct rg_wavefront* self)
+{
+  if (self) {
+    rg_aligned_free(self->queues[0]);
+    rg_aligned_free(self->queues[1]);
+    free(self->queue_paths[0]);
+    free(self->queue_paths[1]);
+    rg_aligned_free(self->shadow_rays);
+    free(self->shadow_paths);
+    free(self->shadow_colors);
+    free(self->ray_ids);
+    free(self->emit_bounce);
+    free(self->identity);
+    free(self->states);
+  }
+
+  free(self);
+}
+
+/**
+ * @brief Tests the queued shadow rays for occlusion, and adds the contribution of the unoccluded ones to their paths.
+ * */
+static void
+flush_shadow_rays(struct rg_wavefront* self)
+{
+  if (self->shadow_count == 0) {
+    return;
+  }
+
+  struct RTCIntersectContext context;
+
+  rtcInitIntersectContext(&context);
+
+  rtcOccluded1M(self->scene, &context, self->shadow_rays, self->shadow_count, sizeof(struct RTCRay));
+
+  for (uint32_t i = 0; i < self->shadow_count; i++) {
+
+    /* Embree marks occluded rays by setting tfar to negative infinity. */
+    if (self->shadow_rays[i].tfar == -INFINITY) {
+      continue;
+    }
+
+    const uint32_t path = self->shadow_paths[i];
+
+    self->r[path] += self->shadow_colors[i * 3 + 0];
+    self->g[path] += self->shadow_colors[i * 3 + 1];
+    self->b[path] += self->shadow_colors[i * 3 + 2];
+  }
+
+  self->shadow_count = 0;
+}
+
+void
+rg_wavefront_trace(struct rg_wavefront* self,
+                   const struct raygun_interface* interface,
+                   void* caller,
+                   RTCScene scene,
+                   struct raygun_context* context,
+                   struct RTCRayHit* camera_rays,
+                   const uint32_t count,
+                   float* r,
+                   float* g,
+                   float* b)
+{
+  self->scene = scene;
+  self->num_paths = count;
+  self->r = r;
+  self->g = g;
+  self->b = b;
+
+  for (uint32_t i = 0; i < count; i++) {
+    self->ray_ids[i] = camera_rays[i].ray.id;
+    self->emit_bounce[i] = 0;
+    r[i] = 0.0f;
+    g[i] = 0.0f;
+    b[i] = 0.0f;
+  }
+
+  struct RTCRayHit* rays = camera_rays;
+
+  const uint32_t* paths = self->identity;
+
+  uint32_t num_rays = count;
+
+  self->bounce = 0;
+  self->next_queue = 0;
+  self->shadow_count = 0;
+
+  while (num_rays > 0) {
+
+    self->bounce++;
+    self->next_count = 0;
+
+    struct RTCIntersectContext intersect_context;
+
+    rtcInitIntersectContext(&intersect_context);
+
+    /* Only the camera rays are coherent. Past the first bounce, neighboring rays scatter in different directions. */
+    if (self->bounce == 1) {
+      intersect_context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+    }
+
+    rtcIntersect1M(scene, &intersect_context, rays, num_rays, sizeof(struct RTCRayHit));
+
+    interface->shade(caller, scene, context, self->bounce - 1, num_rays, paths, rays);
+
+    flush_shadow_rays(self);
+
+    rays = self->queues[self->next_queue];
+    paths = self->queue_paths[self->next_queue];
+    num_rays = self->next_count;
+
+    self->next_queue ^= 1;
+  }
+
+  self->num_paths = 0;
+}
+
+int
+rg_wavefront_emit(struct rg_wavefront* self, const uint32_t path, const struct RTCRay* ray)
+{
+  if ((path >= self->num_paths) || (self->emit_bounce[path] == self->bounce)) {
+    return -1;
+  }
+
+  self->emit_bounce[path] = self->bounce;
+
+  const uint32_t i = self->next_count;
+
+  struct RTCRayHit* ray_hit = &self->queues[self->next_queue][i];
+
+  ray_hit->ray = *ray;
+  ray_hit->ray.id = self->ray_ids[path];
+  ray_hit->hit.geomID = RTC_INVALID_GEOMETRY_ID;
+  ray_hit->hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+
+  self->queue_paths[self->next_queue][i] = path;
+
+  self->next_count++;
+
+  return 0;
+}
+
+void
+rg_wavefront_emit_shadow(struct rg_wavefront* self,
+                         const uint32_t path,
+                         const struct RTCRay* ray,
+                         const float r,
+                         const float g,
+                         const float b)
+{
+  if (path >= self->num_paths) {
+    return;
+  }
+
+  if (self->shadow_count == self->capacity) {
+    flush_shadow_rays(self);
+  }
+
+  const uint32_t i = self->shadow_count;
+
+  self->shadow_rays[i] = *ray;
+  self->shadow_rays[i].id = self->ray_ids[path];
+  self->shadow_paths[i] = path;
+  self->shadow_colors[i * 3 + 0] = r;
+  self->shadow_colors[i * 3 + 1] = g;
+  self->shadow_colors[i * 3 + 2] = b;
+
+  self->shadow_count++;
+}
+
+void
+rg_wavefront_add(struct rg_wavefront* self, const uint32_t path, const float r, const float g, const float b)
+{
+  if (path >= self->num_paths) {
+    return;
+  }
+
+  self->r[path] += r;
+  self->g[path] += g;
+  self->b[path] += b;
+}
+
+void*
+rg_wavefront_state(struct rg_wavefront* self, const uint32_t path)
+{
+  if (!self->states || (path >= self->num_paths)) {
+    return NULL;
+  }
+
+  return self->states + (size_t)path * self->state_size;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <raygun.h>
+
+#include <embree3/rtcore.h>
+
+#include <stdint.h>
+
+/**
+ * @brief The ray queues of one render thread, for the wavefront integration model.
+ *
+ * @details Instead of tracing each path to completion inside of the trace callback, the paths of a tile advance in
+ *          lockstep, one bounce at a time. Each bounce intersects all queued extension rays with one stream call, and
+ *          passes the hits to the shade callback, which emits the rays of the next bounce. Shadow rays are gathered in a
+ *          separate queue and tested for occlusion in batches, adding their contribution to the path if unoccluded.
+ *
+ *          Paths are identified by their index in the tile, which is also the index of the camera ray that started
+ *          them. Each path may emit at most one extension ray per bounce, so the queues never need to grow.
+ * */
+struct rg_wavefront;
+
+/**
+ * @brief Creates the queues for a thread.
+ *
+ * @param capacity The largest number of paths traced at once.
+ *
+ * @param state_size The number of bytes of user state that are kept for each path.
+ *
+ * @return On success, a pointer to the queues. On failure, a null pointer.
+ * */
+struct rg_wavefront*
+rg_wavefront_new(uint32_t capacity, uint32_t state_size);
+
+void
+rg_wavefront_delete(struct rg_wavefront* self);
+
+/**
+ * @brief Traces a set of paths until none of them emits another extension ray.
+ *
+ * @param camera_rays The first ray of each path. These are intersected in place.
+ *
+ * @param count The number of paths, which must not exceed the capacity of the queues.
+ *
+ * @param r Assigned the radiance gathered by each path.
+ * */
+void
+rg_wavefront_trace(struct rg_wavefront* self,
+                   const struct raygun_interface* interface,
+                   void* caller,
+                   RTCScene scene,
+                   struct raygun_context* context,
+                   struct RTCRayHit* camera_rays,
+                   uint32_t count,
+                   float* r,
+                   float* g,
+                   float* b);
+
+/**
+ * @brief Queues the extension ray of a path for the next bounce.
+ *
+ * @note The path index comes from the caller, so this and the functions below check it against the number of paths
+ *       being traced, and ignore indices that are out of range.
+ *
+ * @return Zero on success, or -1 if the path already emitted an extension ray in this bounce, or doesn't exist.
+ * */
+int
+rg_wavefront_emit(struct rg_wavefront* self, uint32_t path, const struct RTCRay* ray);
+
+/**
+ * @brief Queues a shadow ray. If nothing occludes it, the color is added to the radiance of the path.
+ * */
+void
+rg_wavefront_emit_shadow(struct rg_wavefront* self, uint32_t path, const struct RTCRay* ray, float r, float g, float b);
+
+/**
+ * @brief Adds to the radiance of a path, such as the light emitted by a surface it hit.
+ * */
+void
+rg_wavefront_add(struct rg_wavefront* self, uint32_t path, float r, float g, float b);
+
+/**
+ * @brief Gets the user state of a path, or a null pointer if there is none or the path doesn't exist.
+ * */
+void*
+rg_wavefront_state(struct rg_wavefront* self, uint32_t path);
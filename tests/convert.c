@@ -0,0 +1,170 @@
+/* Checks that the conversion to half precision is bit-exact, by converting every finite half, the midpoint between
+ * each pair of neighbouring halfs and the floats right next to each midpoint, which are all the points where the
+ * rounding changes. The values are converted both in bulk, which takes the vectorized path where there is one, and
+ * one at a time, which takes the scalar path. */
+
+#include "convert.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The number of finite, non-negative halfs, which are 0x0000 to 0x7bff.
+ * */
+#define NUM_FINITE_HALFS 0x7c00u
+
+struct test_case
+{
+  float value;
+
+  uint16_t expected;
+};
+
+static double
+half_to_double(const uint16_t h)
+{
+  const int exponent = (h >> 10) & 0x1f;
+
+  const int mantissa = h & 0x3ff;
+
+  if (exponent == 0x1f) {
+    return INFINITY;
+  }
+
+  if (exponent == 0) {
+    return ldexp((double)mantissa, -24);
+  }
+
+  return ldexp((double)(mantissa | 0x400), exponent - 25);
+}
+
+static size_t
+add_case(struct test_case* cases, size_t count, const float value, const uint16_t expected)
+{
+  cases[count].value = value;
+  cases[count].expected = expected;
+  count++;
+
+  cases[count].value = -value;
+  cases[count].expected = (uint16_t)(expected | 0x8000u);
+  count++;
+
+  return count;
+}
+
+static int
+is_nan_half(const uint16_t h)
+{
+  return ((h & 0x7c00u) == 0x7c00u) && ((h & 0x3ffu) != 0);
+}
+
+static int
+check(const struct test_case* cases, const size_t count, const uint16_t* halfs, const char* path)
+{
+  int failures = 0;
+
+  for (size_t i = 0; i < count; i++) {
+
+    if (halfs[i] == cases[i].expected) {
+      continue;
+    }
+
+    if (failures < 10) {
+      fprintf(stderr,
+              "%s: %.9g became 0x%04x instead of 0x%04x\n",
+              path,
+              (double)cases[i].value,
+              (unsigned)halfs[i],
+              (unsigned)cases[i].expected);
+    }
+
+    failures++;
+  }
+
+  return failures;
+}
+
+int
+main(void)
+{
+  const size_t max_cases = NUM_FINITE_HALFS * 8 + 16;
+
+  struct test_case* cases = malloc(sizeof(struct test_case) * max_cases);
+  float* values = malloc(sizeof(float) * max_cases);
+  uint16_t* halfs = malloc(sizeof(uint16_t) * max_cases);
+
+  if (!cases || !values || !halfs) {
+    fprintf(stderr, "Failed to allocate the test cases.\n");
+    return EXIT_FAILURE;
+  }
+
+  size_t count = 0;
+
+  for (uint16_t h = 0; h < NUM_FINITE_HALFS; h++) {
+
+    const uint16_t next = (uint16_t)(h + 1);
+
+    /* The halfs after the largest finite one, 65504, round to infinity, which is then the next value. */
+
+    const double upper = (next == NUM_FINITE_HALFS) ? 65536.0 : half_to_double(next);
+
+    const float value = (float)half_to_double(h);
+
+    const float midpoint = (float)((half_to_double(h) + upper) * 0.5);
+
+    count = add_case(cases, count, value, h);
+    count = add_case(cases, count, midpoint, (h & 1u) ? next : h);
+    count = add_case(cases, count, nextafterf(midpoint, 0.0f), h);
+    count = add_case(cases, count, nextafterf(midpoint, INFINITY), next);
+  }
+
+  count = add_case(cases, count, 1.0e-30f, 0x0000u);
+  count = add_case(cases, count, 1.0e10f, 0x7c00u);
+  count = add_case(cases, count, INFINITY, 0x7c00u);
+
+  for (size_t i = 0; i < count; i++) {
+    values[i] = cases[i].value;
+  }
+
+  int failures = 0;
+
+  rg_convert_f16(values, count, halfs);
+
+  failures += check(cases, count, halfs, "bulk");
+
+  for (size_t i = 0; i < count; i++) {
+    rg_convert_f16(values + i, 1, halfs + i);
+  }
+
+  failures += check(cases, count, halfs, "scalar");
+
+  /* NaN has no single expected encoding, but it must stay NaN on both paths. */
+
+  for (size_t i = 0; i < 16; i++) {
+    values[i] = (i & 1u) ? -NAN : NAN;
+  }
+
+  rg_convert_f16(values, 16, halfs);
+
+  rg_convert_f16(values, 1, halfs + 16);
+
+  for (size_t i = 0; i < 17; i++) {
+    if (!is_nan_half(halfs[i])) {
+      fprintf(stderr, "NaN became 0x%04x\n", (unsigned)halfs[i]);
+      failures++;
+    }
+  }
+
+  free(cases);
+  free(values);
+  free(halfs);
+
+  if (failures > 0) {
+    fprintf(stderr, "%d conversions were wrong.\n", failures);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/* Renders a constant color through the EGL backend with the layout, precision and resolve mode given on the command
+ * line, and checks every pixel that is read back.
+ *
+ * Usage: offscreen planar|interleaved float|half gpu|cpu */
+
+#include <raygun.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The size of the image. The width is odd, so that the rows of the planar and half precision frames are not
+ *        a multiple of four bytes long.
+ * */
+#define WIDTH 63
+#define HEIGHT 47
+
+static const float color[3] = { 1.0f, 0.25f, 0.0f };
+
+static void
+setup(void* caller, RTCDevice device, RTCScene scene)
+{
+  (void)caller;
+  (void)device;
+
+  rtcCommitScene(scene);
+}
+
+static void
+trace(void* caller,
+      RTCScene scene,
+      struct raygun_context* context,
+      const uint32_t num_rays,
+      const struct RTCRayHit* ray,
+      float* r,
+      float* g,
+      float* b)
+{
+  (void)caller;
+  (void)scene;
+  (void)context;
+  (void)ray;
+
+  for (uint32_t i = 0; i < num_rays; i++) {
+    r[i] = color[0];
+    g[i] = color[1];
+    b[i] = color[2];
+  }
+}
+
+static void
+on_error(void* caller, const char* what)
+{
+  (void)caller;
+
+  fprintf(stderr, "error: %s\n", what);
+}
+
+/**
+ * @brief Gets the 8-bit value that a color component is expected to end up as. The GPU resolve draws linear values,
+ *        while the CPU resolve encodes them as sRGB.
+ * */
+static int
+expected_value(const float value, const int srgb)
+{
+  double x = (double)value;
+
+  if (srgb) {
+    x = (x <= 0.0031308) ? (x * 12.92) : (1.055 * pow(x, 1.0 / 2.4) - 0.055);
+  }
+
+  return (int)(x * 255.0 + 0.5);
+}
+
+int
+main(int argc, char** argv)
+{
+  if (argc != 4) {
+    fprintf(stderr, "usage: %s planar|interleaved float|half gpu|cpu\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  struct raygun_config config;
+
+  raygun_config_init(&config);
+
+  config.color_layout = (strcmp(argv[1], "interleaved") == 0) ? RAYGUN_COLOR_LAYOUT_INTERLEAVED
+                                                              : RAYGUN_COLOR_LAYOUT_PLANAR;
+  config.half_float_upload = strcmp(argv[2], "half") == 0;
+  config.resolve_mode = (strcmp(argv[3], "cpu") == 0) ? RAYGUN_RESOLVE_CPU : RAYGUN_RESOLVE_GPU;
+
+  struct raygun_interface interface;
+
+  memset(&interface, 0, sizeof(interface));
+
+  interface.setup = setup;
+  interface.trace = trace;
+  interface.error = on_error;
+
+  static unsigned char pixels[WIDTH * HEIGHT * 4];
+
+  const uint32_t max_frames = 4;
+
+  const int frames = raygun_exec_offscreen(NULL, &interface, &config, WIDTH, HEIGHT, pixels, max_frames, 0.0);
+
+  if (frames != (int)max_frames) {
+    fprintf(stderr, "presented %d frames instead of %u\n", frames, (unsigned)max_frames);
+    return EXIT_FAILURE;
+  }
+
+  const int srgb = config.resolve_mode == RAYGUN_RESOLVE_CPU;
+
+  int failures = 0;
+
+  for (int i = 0; i < (WIDTH * HEIGHT); i++) {
+
+    for (int c = 0; c < 3; c++) {
+
+      const int expected = expected_value(color[c], srgb);
+
+      const int actual = pixels[i * 4 + c];
+
+      if (abs(actual - expected) <= 1) {
+        continue;
+      }
+
+      if (failures < 10) {
+        fprintf(stderr,
+                "pixel (%d, %d), channel %d is %d instead of %d\n",
+                i % WIDTH,
+                i / WIDTH,
+                c,
+                actual,
+                expected);
+      }
+
+      failures++;
+    }
+  }
+
+  if (failures > 0) {
+    fprintf(stderr, "%d pixel values were wrong.\n", failures);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}